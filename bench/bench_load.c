@@ -0,0 +1,403 @@
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "netpulse_monitor.h"
+
+/* End-to-end load benchmark. It runs the monitor core on a main loop, exactly as the headless daemon does,
+   against stand-in responders on loopback, and reports probe throughput, wheel tick cost and memory.
+
+   icmp     127.0.0.0/8 addresses, answered by the kernel's loopback echo responder
+   tcp      tcp:// targets on 127.0.0.0/8, accepted by the local responder
+   http     http:// targets served by the local responder
+   backend  plain hosts sent to the local responder acting as a batch probe backend */
+
+typedef enum {
+    BENCH_ICMP,
+    BENCH_TCP,
+    BENCH_HTTP,
+    BENCH_BACKEND,
+} BenchMode;
+
+static const char *const BENCH_MODE_NAMES[] = {"icmp", "tcp", "http", "backend"};
+
+typedef struct {
+    int listen_fd;
+    int epfd;
+    int port;
+    gint stop;
+    GThread *thread;
+} Responder;
+
+typedef struct {
+    int fd;
+    GString *in;
+} Connection;
+
+typedef struct {
+    Monitor monitor;
+    GMainLoop *loop;
+    GArray *tick_ns;
+    guint64 samples;
+    guint64 failures;
+    bool verbose;
+} Bench;
+
+static void close_connection(Responder *responder, Connection *conn) {
+    epoll_ctl(responder->epfd, EPOLL_CTL_DEL, conn->fd, NULL);
+    close(conn->fd);
+    g_string_free(conn->in, TRUE);
+    g_free(conn);
+}
+
+/* Answers a batch request with one result per target in the request body. */
+static void append_batch_body(GString *out, const char *body, size_t len) {
+    const char *p = memchr(body, '[', len);
+    const char *end = body + len;
+    g_string_append_c(out, '[');
+    bool first = true;
+    while (p != NULL && p < end) {
+        const char *open = memchr(p, '"', (size_t)(end - p));
+        if (open == NULL) {
+            break;
+        }
+        const char *close_quote = memchr(open + 1, '"', (size_t)(end - open - 1));
+        if (close_quote == NULL) {
+            break;
+        }
+        g_string_append_printf(out, "%s{\"target\":\"%.*s\",\"ok\":true,\"latency_ms\":0.4}\n", first ? "" : ",",
+                               (int)(close_quote - open - 1), open + 1);
+        first = false;
+        p = close_quote + 1;
+    }
+    g_string_append_c(out, ']');
+}
+
+/* Handles every complete request in the buffer and returns false when the connection should be dropped. */
+static bool serve_requests(Connection *conn, GString *response, GString *body) {
+    for (;;) {
+        char *headers_end = strstr(conn->in->str, "\r\n\r\n");
+        if (headers_end == NULL) {
+            return true;
+        }
+        size_t header_len = (size_t)(headers_end - conn->in->str) + 4;
+        size_t content_len = 0;
+        char *length = strcasestr(conn->in->str, "\r\nContent-Length:");
+        if (length != NULL && length < headers_end) {
+            content_len = strtoul(length + 17, NULL, 10);
+        }
+        if (conn->in->len < header_len + content_len) {
+            return true;
+        }
+
+        bool head = strncmp(conn->in->str, "HEAD ", 5) == 0;
+        g_string_truncate(body, 0);
+        if (strncmp(conn->in->str, "POST ", 5) == 0) {
+            append_batch_body(body, conn->in->str + header_len, content_len);
+        } else if (strstr(conn->in->str, "target=") != NULL && strstr(conn->in->str, "target=") < headers_end) {
+            g_string_append(body, "{\"ok\":true,\"latency_ms\":0.4}");
+        }
+        g_string_printf(response,
+                        "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nX-NetPulse-Batch: 1\r\n"
+                        "Content-Length: %zu\r\n\r\n",
+                        body->len);
+        if (!head) {
+            g_string_append_len(response, body->str, (gssize)body->len);
+        }
+        g_string_erase(conn->in, 0, (gssize)(header_len + content_len));
+        if (send(conn->fd, response->str, response->len, MSG_NOSIGNAL) != (ssize_t)response->len) {
+            return false;
+        }
+    }
+}
+
+static gpointer responder_thread(gpointer user_data) {
+    Responder *responder = user_data;
+    struct epoll_event events[64];
+    GString *response = g_string_sized_new(1024);
+    GString *body = g_string_sized_new(1024);
+    char buffer[16384];
+
+    while (!g_atomic_int_get(&responder->stop)) {
+        int ready = epoll_wait(responder->epfd, events, 64, 100);
+        for (int i = 0; i < ready; ++i) {
+            Connection *conn = events[i].data.ptr;
+            if (conn == NULL) {
+                int fd;
+                /* Accepted sockets stay blocking for writes; reads use MSG_DONTWAIT. */
+                while ((fd = accept4(responder->listen_fd, NULL, NULL, SOCK_CLOEXEC)) >= 0) {
+                    Connection *accepted = g_new0(Connection, 1);
+                    accepted->fd = fd;
+                    accepted->in = g_string_sized_new(512);
+                    struct epoll_event event = {.events = EPOLLIN, .data.ptr = accepted};
+                    epoll_ctl(responder->epfd, EPOLL_CTL_ADD, fd, &event);
+                }
+                continue;
+            }
+
+            ssize_t n = recv(conn->fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+            if (n < 0 && (errno == EAGAIN || errno == EINTR)) {
+                continue;
+            }
+            if (n <= 0) {
+                close_connection(responder, conn);
+                continue;
+            }
+            g_string_append_len(conn->in, buffer, n);
+            if (!serve_requests(conn, response, body)) {
+                close_connection(responder, conn);
+            }
+        }
+    }
+    g_string_free(response, TRUE);
+    g_string_free(body, TRUE);
+    return NULL;
+}
+
+/* Listens on all addresses so that every 127.0.0.0/8 target reaches the same responder. */
+static bool responder_start(Responder *responder) {
+    memset(responder, 0, sizeof(*responder));
+    responder->listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (responder->listen_fd < 0) {
+        return false;
+    }
+    int one = 1;
+    setsockopt(responder->listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_ANY)};
+    socklen_t addr_len = sizeof(addr);
+    if (bind(responder->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(responder->listen_fd, 4096) != 0 ||
+        getsockname(responder->listen_fd, (struct sockaddr *)&addr, &addr_len) != 0) {
+        close(responder->listen_fd);
+        return false;
+    }
+    responder->port = ntohs(addr.sin_port);
+    responder->epfd = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event event = {.events = EPOLLIN, .data.ptr = NULL};
+    epoll_ctl(responder->epfd, EPOLL_CTL_ADD, responder->listen_fd, &event);
+    responder->thread = g_thread_new("bench-responder", responder_thread, responder);
+    return true;
+}
+
+static void responder_stop(Responder *responder) {
+    g_atomic_int_set(&responder->stop, 1);
+    g_thread_join(responder->thread);
+    close(responder->epfd);
+    close(responder->listen_fd);
+}
+
+static void loopback_address(int index, char *out, size_t out_size) {
+    uint32_t addr = 0x7F000001u + (uint32_t)index;
+    snprintf(out, out_size, "127.%u.%u.%u", addr >> 16 & 255, addr >> 8 & 255, addr & 255);
+}
+
+static char **build_targets(BenchMode mode, int count, int port) {
+    char **targets = g_new0(char *, count + 1);
+    char address[32];
+    for (int i = 0; i < count; ++i) {
+        loopback_address(i, address, sizeof(address));
+        switch (mode) {
+        case BENCH_TCP:
+            targets[i] = g_strdup_printf("tcp://%s:%d", address, port);
+            break;
+        case BENCH_HTTP:
+            targets[i] = g_strdup_printf("http://127.0.0.1:%d/t/%d", port, i);
+            break;
+        default:
+            targets[i] = g_strdup(address);
+            break;
+        }
+    }
+    return targets;
+}
+
+static void on_log(const char *timestamp, const char *message, gpointer user_data) {
+    Bench *bench = user_data;
+    if (bench->verbose) {
+        fprintf(stderr, "[%s] %s\n", timestamp, message);
+    }
+}
+
+static void on_sample(Target *target, gpointer user_data) {
+    Bench *bench = user_data;
+    bench->samples++;
+    if (!target->last_success) {
+        bench->failures++;
+    }
+}
+
+static void on_tick(int64_t duration_ns, gpointer user_data) {
+    Bench *bench = user_data;
+    g_array_append_val(bench->tick_ns, duration_ns);
+}
+
+static gboolean on_deadline(gpointer user_data) {
+    g_main_loop_quit(user_data);
+    return G_SOURCE_REMOVE;
+}
+
+static int compare_int64(const void *a, const void *b) {
+    int64_t x = *(const int64_t *)a;
+    int64_t y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static double tick_percentile_us(GArray *ticks, double q) {
+    if (ticks->len == 0) {
+        return 0.0;
+    }
+    guint index = (guint)(q * (ticks->len - 1) + 0.5);
+    return (double)g_array_index(ticks, int64_t, index) / 1000.0;
+}
+
+static void print_memory(void) {
+    FILE *f = fopen("/proc/self/status", "r");
+    if (f == NULL) {
+        return;
+    }
+    char line[256];
+    while (fgets(line, sizeof(line), f) != NULL) {
+        if (strncmp(line, "VmRSS:", 6) == 0 || strncmp(line, "VmHWM:", 6) == 0) {
+            fputs(line, stdout);
+        }
+    }
+    fclose(f);
+}
+
+static void usage(const char *argv0) {
+    fprintf(stderr,
+            "Usage: %s [-m icmp|tcp|http|backend] [-n targets] [-t seconds] [-i interval] [-r rate] [-v]\n",
+            argv0);
+}
+
+int main(int argc, char **argv) {
+    BenchMode mode = BENCH_TCP;
+    int target_count = 1000;
+    int seconds = 10;
+    int interval_sec = 1;
+    double probe_rate = 0.0;
+    bool verbose = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "m:n:t:i:r:v")) != -1) {
+        switch (opt) {
+        case 'm': {
+            bool known = false;
+            for (size_t i = 0; i < G_N_ELEMENTS(BENCH_MODE_NAMES); ++i) {
+                if (strcmp(optarg, BENCH_MODE_NAMES[i]) == 0) {
+                    mode = (BenchMode)i;
+                    known = true;
+                }
+            }
+            if (!known) {
+                usage(argv[0]);
+                return 2;
+            }
+            break;
+        }
+        case 'n':
+            target_count = atoi(optarg);
+            break;
+        case 't':
+            seconds = atoi(optarg);
+            break;
+        case 'i':
+            interval_sec = atoi(optarg);
+            break;
+        case 'r':
+            probe_rate = g_ascii_strtod(optarg, NULL);
+            break;
+        case 'v':
+            verbose = true;
+            break;
+        default:
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (target_count <= 0 || seconds <= 0 || interval_sec <= 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    /* Run from an empty directory so a saved netpulse_c_config.txt cannot add targets. */
+    gchar *workdir = g_dir_make_tmp("netpulse-bench-XXXXXX", NULL);
+    if (workdir == NULL || chdir(workdir) != 0) {
+        fprintf(stderr, "Could not create a scratch directory.\n");
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    Responder responder;
+    if (!responder_start(&responder)) {
+        fprintf(stderr, "Could not start the loopback responder: %s\n", strerror(errno));
+        return 1;
+    }
+
+    char **targets = build_targets(mode, target_count, responder.port);
+    gchar *backend_url = g_strdup_printf("http://127.0.0.1:%d/probe", responder.port);
+    MonitorOptions options = {
+        .interval_sec = interval_sec,
+        .stats_window_sec = DEFAULT_STATS_WINDOW_SEC,
+        .probe_rate = probe_rate,
+        .http_reuse = true,
+        .backend_url = mode == BENCH_BACKEND ? backend_url : NULL,
+        .engine = PROBE_ENGINE_NATIVE,
+        .headless = true,
+        .targets = targets,
+        .target_count = target_count,
+    };
+
+    Bench *bench = g_new0(Bench, 1);
+    bench->loop = g_main_loop_new(NULL, FALSE);
+    bench->tick_ns = g_array_sized_new(FALSE, FALSE, sizeof(int64_t), (guint)seconds * 10);
+    bench->verbose = verbose;
+    MonitorCallbacks callbacks = {
+        .log = on_log,
+        .sample = on_sample,
+        .tick = on_tick,
+        .user_data = bench,
+    };
+    monitor_init(&bench->monitor, &callbacks);
+    monitor_configure(&bench->monitor, &options);
+    if (mode == BENCH_ICMP && bench->monitor.engine != PROBE_ENGINE_NATIVE) {
+        fprintf(stderr, "Native ICMP sockets unavailable; the icmp run measures the ping fallback.\n");
+    }
+
+    int64_t start = monotonic_ns();
+    monitor_start(&bench->monitor);
+    g_timeout_add_seconds((guint)seconds, on_deadline, bench->loop);
+    g_main_loop_run(bench->loop);
+    double elapsed_sec = (double)(monotonic_ns() - start) / 1e9;
+    MonitorCounters counters = bench->monitor.counters;
+    monitor_shutdown(&bench->monitor);
+    responder_stop(&responder);
+
+    g_array_sort(bench->tick_ns, compare_int64);
+    printf("mode=%s targets=%d interval=%ds duration=%.1fs\n", BENCH_MODE_NAMES[mode], target_count, interval_sec,
+           elapsed_sec);
+    printf("probes=%" G_GUINT64_FORMAT " failures=%" G_GUINT64_FORMAT " probes/sec=%.0f deferred=%" G_GUINT64_FORMAT
+           "\n",
+           bench->samples, bench->failures, (double)bench->samples / elapsed_sec, counters.probes_deferred);
+    printf("ticks=%u tick_us p50=%.1f p90=%.1f p99=%.1f max=%.1f\n", bench->tick_ns->len,
+           tick_percentile_us(bench->tick_ns, 0.50), tick_percentile_us(bench->tick_ns, 0.90),
+           tick_percentile_us(bench->tick_ns, 0.99), tick_percentile_us(bench->tick_ns, 1.0));
+    print_memory();
+
+    g_array_free(bench->tick_ns, TRUE);
+    g_main_loop_unref(bench->loop);
+    g_free(bench);
+    g_strfreev(targets);
+    g_free(backend_url);
+    rmdir(workdir);
+    g_free(workdir);
+    return 0;
+}
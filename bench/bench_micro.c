@@ -0,0 +1,141 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "netpulse_json.h"
+#include "netpulse_targets.h"
+
+/* Microbenchmarks for the per-probe hot paths. Each case runs a fixed number of iterations and reports
+   the mean cost per call; pass a scale factor to run more or fewer iterations. */
+
+static volatile size_t sink;
+
+static void report(const char *name, long ops, int64_t elapsed_ns) {
+    double per_op = (double)elapsed_ns / (double)ops;
+    printf("%-24s %10ld ops %10.1f ns/op %14.0f ops/s\n", name, ops, per_op, per_op > 0.0 ? 1e9 / per_op : 0.0);
+}
+
+static void bench_normalize_target(long iterations) {
+    static const char *const inputs[] = {
+        "example.com",
+        "  8.8.8.8  ",
+        "https://status.example.com/health",
+        "tcp://db.internal:5432",
+        "[2001:db8::1]:443",
+        "2001:db8::42",
+        "router.lan:22",
+    };
+    size_t count = sizeof(inputs) / sizeof(inputs[0]);
+    char display[256];
+    char host[256];
+    int port = 0;
+
+    int64_t start = monotonic_ns();
+    for (long i = 0; i < iterations; ++i) {
+        sink += normalize_target(inputs[i % count], display, sizeof(display), host, sizeof(host), &port);
+    }
+    report("normalize_target", iterations, monotonic_ns() - start);
+}
+
+static void bench_history(long iterations) {
+    Target *target = calloc(1, sizeof(Target));
+    init_history(target, DEFAULT_STATS_WINDOW_SEC);
+
+    int64_t start = monotonic_ns();
+    for (long i = 0; i < iterations; ++i) {
+        add_history(target, i % 50 != 0, 5.0 + (double)(i % 97) * 0.25, true);
+    }
+    report("add_history", iterations, monotonic_ns() - start);
+
+    start = monotonic_ns();
+    for (long i = 0; i < iterations; ++i) {
+        compute_status(target);
+        sink += (size_t)target->status[0];
+    }
+    report("compute_status", iterations, monotonic_ns() - start);
+
+    char latency[32];
+    char avg[32];
+    char uptime[32];
+    long stats_iterations = iterations / 10;
+    start = monotonic_ns();
+    for (long i = 0; i < stats_iterations; ++i) {
+        compute_stats(target, latency, sizeof(latency), avg, sizeof(avg), uptime, sizeof(uptime));
+        sink += (size_t)latency[0];
+    }
+    report("compute_stats", stats_iterations, monotonic_ns() - start);
+
+    char percentiles[64];
+    char jitter[32];
+    start = monotonic_ns();
+    for (long i = 0; i < stats_iterations; ++i) {
+        compute_tail_stats(target, percentiles, sizeof(percentiles), jitter, sizeof(jitter));
+        sink += (size_t)percentiles[0];
+    }
+    report("compute_tail_stats", stats_iterations, monotonic_ns() - start);
+
+    RollupStats rollup;
+    time_t now = time(NULL);
+    start = monotonic_ns();
+    for (long i = 0; i < stats_iterations; ++i) {
+        sink += target_rollup_stats(target, now, 30 * 86400, false, &rollup);
+    }
+    report("target_rollup_stats(30d)", stats_iterations, monotonic_ns() - start);
+    free_history(target);
+    free(target);
+}
+
+static void count_result(const ProbeResult *result, void *user_data) {
+    size_t *count = user_data;
+    *count += result->ok;
+}
+
+static void bench_json(long iterations) {
+    static const char object[] = "{\"target\":\"db-01.example.com\",\"ok\":true,\"latency_ms\":12.375,"
+                                 "\"loss_pct\":0,\"jitter_ms\":0.82,\"samples\":5,\"meta\":{\"pop\":\"fra\"}}";
+    const char *end = object + sizeof(object) - 1;
+    ProbeResult result;
+
+    int64_t start = monotonic_ns();
+    for (long i = 0; i < iterations; ++i) {
+        sink += probe_result_parse(object, end, &result) != NULL;
+    }
+    report("probe_result_parse", iterations, monotonic_ns() - start);
+
+    /* A batch response of the size a large backend returns in one body. */
+    long objects = 100000;
+    size_t capacity = (size_t)objects * 96 + 16;
+    char *batch = malloc(capacity);
+    size_t len = 0;
+    batch[len++] = '[';
+    for (long i = 0; i < objects; ++i) {
+        len += (size_t)snprintf(batch + len, capacity - len,
+                                "%s{\"target\":\"10.%ld.%ld.%ld\",\"ok\":true,\"latency_ms\":%ld.%03ld}",
+                                i > 0 ? "," : "", i >> 16 & 255, i >> 8 & 255, i & 255, i % 200, i % 1000);
+    }
+    batch[len++] = ']';
+
+    long rounds = iterations / objects > 0 ? iterations / objects : 1;
+    size_t parsed = 0;
+    start = monotonic_ns();
+    for (long i = 0; i < rounds; ++i) {
+        probe_results_scan(batch, len, count_result, &parsed);
+    }
+    int64_t elapsed = monotonic_ns() - start;
+    sink += parsed;
+    report("probe_results_scan", rounds * objects, elapsed);
+    printf("%-24s %10.1f MB/s\n", "", (double)(len * (size_t)rounds) / 1e6 / ((double)elapsed / 1e9));
+    free(batch);
+}
+
+int main(int argc, char **argv) {
+    double scale = argc > 1 ? atof(argv[1]) : 1.0;
+    long iterations = (long)(1000000 * (scale > 0.0 ? scale : 1.0));
+
+    printf("netpulse microbenchmarks (%ld iterations)\n", iterations);
+    bench_normalize_target(iterations);
+    bench_history(iterations);
+    bench_json(iterations);
+    return 0;
+}
@@ -0,0 +1,439 @@
+#define _POSIX_C_SOURCE 200809L
+#include "netpulse_alerts.h"
+
+#include <curl/curl.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "netpulse_json.h"
+
+typedef enum {
+    ALERT_SINK_EXEC,
+    ALERT_SINK_WEBHOOK,
+    ALERT_SINK_FILE,
+} AlertSinkType;
+
+typedef struct {
+    AlertSinkType type;
+    char *target;
+    FILE *file;
+    CURL *curl;
+    struct curl_slist *headers;
+} AlertSink;
+
+/* Events go from the main loop to the sink thread through a single-producer, single-consumer ring: the
+   main loop only advances head and the sink thread only advances tail, so neither side takes a lock and a
+   full ring drops the event instead of blocking a probe result. The sink thread sleeps on wake while the
+   ring is empty, and the main loop only takes wake_lock to signal it when a push finds the ring empty. */
+struct AlertPipeline {
+    AlertEvent *slots;
+    guint head;
+    guint tail;
+    AlertSink sinks[MAX_ALERT_SINKS];
+    int sink_count;
+    GThread *thread;
+    gint stop;
+    GMutex wake_lock;
+    GCond wake;
+    AlertCounters counters;
+};
+
+int flap_state_update(FlapState *state, int64_t now_ns, bool changed) {
+    if (state->updated_ns > 0) {
+        state->score *= exp2(-(double)(now_ns - state->updated_ns) / 1e9 / FLAP_HALF_LIFE_SEC);
+    }
+    state->updated_ns = now_ns;
+    if (changed) {
+        state->score += 1.0;
+    }
+
+    if (!state->active && state->score > FLAP_START_SCORE) {
+        state->active = true;
+        return 1;
+    }
+    if (state->active && state->score < FLAP_STOP_SCORE) {
+        state->active = false;
+        return -1;
+    }
+    return 0;
+}
+
+static const char *alert_event_name(AlertKind kind) {
+    switch (kind) {
+    case ALERT_FLAP_START:
+        return "flapping";
+    case ALERT_FLAP_END:
+        return "flap_cleared";
+    default:
+        return "transition";
+    }
+}
+
+static const char *alert_change_name(const AlertEvent *event) {
+    if (strcmp(event->to, "GREEN") == 0) {
+        return "recovered";
+    }
+    if (strcmp(event->to, "RED") == 0) {
+        return "critical";
+    }
+    return strcmp(event->from, "RED") == 0 ? "improving" : "degraded";
+}
+
+static void append_event_json(GString *out, const AlertEvent *event) {
+    char number[G_ASCII_DTOSTR_BUF_SIZE];
+    g_string_append_printf(out, "{\"event\":\"%s\",\"ts\":%s,\"id\":%u,\"target\":", alert_event_name(event->kind),
+                           g_ascii_formatd(number, sizeof(number), "%.3f", event->timestamp), event->target_id);
+    append_json_string(out, event->target);
+    g_string_append(out, ",\"host\":");
+    append_json_string(out, event->host);
+    if (event->kind == ALERT_TRANSITION) {
+        g_string_append_printf(out, ",\"from\":\"%s\",\"to\":\"%s\",\"change\":\"%s\"", event->from, event->to,
+                               alert_change_name(event));
+    } else {
+        g_string_append_printf(out, ",\"status\":\"%s\"", event->to);
+    }
+    if (event->has_latency) {
+        g_string_append_printf(out, ",\"latency_ms\":%s",
+                               g_ascii_formatd(number, sizeof(number), "%.3f", event->latency_ms));
+    }
+    g_string_append_c(out, '}');
+}
+
+static size_t discard_body(char *data, size_t size, size_t nmemb, void *user_data) {
+    (void)data;
+    (void)user_data;
+    return size * nmemb;
+}
+
+static bool deliver_webhook(AlertSink *sink, const GString *lines) {
+    GString *body = g_string_sized_new(lines->len + 16);
+    g_string_append(body, "{\"events\":[");
+    size_t start = body->len;
+    g_string_append_len(body, lines->str, (gssize)lines->len - 1);
+    /* Strings are escaped, so the only raw newlines are the line separators. */
+    for (size_t i = start; i < body->len; ++i) {
+        if (body->str[i] == '\n') {
+            body->str[i] = ',';
+        }
+    }
+    g_string_append(body, "]}");
+
+    if (sink->curl == NULL) {
+        sink->curl = curl_easy_init();
+        sink->headers = curl_slist_append(NULL, "Content-Type: application/json");
+    }
+    CURL *curl = sink->curl;
+    curl_easy_setopt(curl, CURLOPT_URL, sink->target);
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, sink->headers);
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, body->str);
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, (long)body->len);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, (long)ALERT_WEBHOOK_TIMEOUT_MS);
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, discard_body);
+
+    long status = 0;
+    bool ok = curl_easy_perform(curl) == CURLE_OK;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+    g_string_free(body, TRUE);
+    return ok && status >= 200 && status < 300;
+}
+
+/* The monitor ignores SIGPIPE, and that would carry over into the hook's shell pipelines. The hook also
+   gets its own process group so a timeout kills everything it started. */
+static void setup_hook_child(gpointer user_data) {
+    (void)user_data;
+    signal(SIGPIPE, SIG_DFL);
+    setpgid(0, 0);
+}
+
+static int remaining_ms(gint64 deadline) {
+    gint64 left = deadline - g_get_monotonic_time();
+    return left > 0 ? (int)((left + 999) / 1000) : 0;
+}
+
+static bool write_all_until(int fd, const GString *lines, gint64 deadline) {
+    size_t written = 0;
+    while (written < lines->len) {
+        struct pollfd pfd = {.fd = fd, .events = POLLOUT};
+        int ready = poll(&pfd, 1, remaining_ms(deadline));
+        if (ready < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ready <= 0) {
+            return false;
+        }
+        ssize_t n = write(fd, lines->str + written, lines->len - written);
+        if (n < 0 && (errno == EINTR || errno == EAGAIN)) {
+            continue;
+        }
+        if (n < 0) {
+            return false;
+        }
+        written += (size_t)n;
+    }
+    return true;
+}
+
+/* The hook command runs once per batch with the batch as NDJSON on stdin. Writing the batch and waiting
+   for the exit share one ALERT_WEBHOOK_TIMEOUT_MS deadline, so a hook that hangs or never reads stdin is
+   killed instead of holding up the other sinks while the ring fills. */
+static bool deliver_exec(const AlertSink *sink, const GString *lines) {
+    gchar *argv[] = {"/bin/sh", "-c", sink->target, NULL};
+    GPid pid;
+    gint stdin_fd = -1;
+    GError *error = NULL;
+    if (!g_spawn_async_with_pipes(NULL, argv, NULL, G_SPAWN_DO_NOT_REAP_CHILD, setup_hook_child, NULL, &pid,
+                                  &stdin_fd, NULL, NULL, &error)) {
+        g_error_free(error);
+        return false;
+    }
+
+    gint64 deadline = g_get_monotonic_time() + (gint64)ALERT_WEBHOOK_TIMEOUT_MS * 1000;
+    fcntl(stdin_fd, F_SETFL, fcntl(stdin_fd, F_GETFL) | O_NONBLOCK);
+    bool written = write_all_until(stdin_fd, lines, deadline);
+    close(stdin_fd);
+
+    int status = 0;
+    pid_t exited;
+    while ((exited = waitpid(pid, &status, WNOHANG)) == 0 && remaining_ms(deadline) > 0) {
+        g_usleep(10 * 1000);
+    }
+    if (exited == 0) {
+        kill(-pid, SIGKILL);
+        waitpid(pid, &status, 0);
+    }
+    g_spawn_close_pid(pid);
+    return exited == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0 && written;
+}
+
+static bool deliver_file(const AlertSink *sink, const GString *lines) {
+    bool written = fwrite(lines->str, 1, lines->len, sink->file) == lines->len;
+    return fflush(sink->file) == 0 && written;
+}
+
+static void deliver_batch(AlertPipeline *pipeline, const GArray *batch, GString *lines) {
+    g_string_truncate(lines, 0);
+    for (guint i = 0; i < batch->len; ++i) {
+        const AlertEvent *event = &g_array_index(batch, AlertEvent, i);
+        /* A change and its reversal inside one batch cancel out. */
+        if (event->kind == ALERT_TRANSITION && strcmp(event->from, event->to) == 0) {
+            continue;
+        }
+        append_event_json(lines, event);
+        g_string_append_c(lines, '\n');
+    }
+    if (lines->len == 0) {
+        return;
+    }
+
+    for (int i = 0; i < pipeline->sink_count; ++i) {
+        AlertSink *sink = &pipeline->sinks[i];
+        bool ok = false;
+        switch (sink->type) {
+        case ALERT_SINK_EXEC:
+            ok = deliver_exec(sink, lines);
+            break;
+        case ALERT_SINK_WEBHOOK:
+            ok = deliver_webhook(sink, lines);
+            break;
+        case ALERT_SINK_FILE:
+            ok = deliver_file(sink, lines);
+            break;
+        }
+        if (!ok) {
+            g_atomic_int_inc(&pipeline->counters.failures);
+        }
+    }
+    g_atomic_int_inc(&pipeline->counters.batches);
+}
+
+/* Moves queued events into the batch. Repeated transitions of one target merge into a single event from
+   its first to its latest status; flap events are kept as they are. */
+static void collect_events(AlertPipeline *pipeline, GArray *batch, GHashTable *pending) {
+    guint tail = pipeline->tail;
+    guint head = (guint)g_atomic_int_get(&pipeline->head);
+    for (; tail != head; ++tail) {
+        const AlertEvent *event = &pipeline->slots[tail & (ALERT_QUEUE_CAPACITY - 1)];
+        gpointer key = GUINT_TO_POINTER(event->target_id);
+        guint index = event->kind == ALERT_TRANSITION ? GPOINTER_TO_UINT(g_hash_table_lookup(pending, key)) : 0;
+        if (index > 0) {
+            AlertEvent *merged = &g_array_index(batch, AlertEvent, index - 1);
+            memcpy(merged->to, event->to, sizeof(merged->to));
+            merged->timestamp = event->timestamp;
+            merged->latency_ms = event->latency_ms;
+            merged->has_latency = event->has_latency;
+            g_atomic_int_inc(&pipeline->counters.coalesced);
+            continue;
+        }
+        g_array_append_vals(batch, event, 1);
+        if (event->kind == ALERT_TRANSITION) {
+            g_hash_table_insert(pending, key, GUINT_TO_POINTER(batch->len));
+        }
+    }
+    g_atomic_int_set(&pipeline->tail, tail);
+}
+
+static void wake_sink_thread(AlertPipeline *pipeline) {
+    g_mutex_lock(&pipeline->wake_lock);
+    g_cond_signal(&pipeline->wake);
+    g_mutex_unlock(&pipeline->wake_lock);
+}
+
+/* With a deadline of 0, sleeps until an event is queued; otherwise sleeps until the deadline. Either way a
+   stop ends the wait. The tail was stored before this checks head, and a push stores head before it checks
+   tail, so one of the two sides always sees the other and an event cannot wait in the ring unnoticed. */
+static void wait_for_events(AlertPipeline *pipeline, gint64 deadline) {
+    g_mutex_lock(&pipeline->wake_lock);
+    while (!g_atomic_int_get(&pipeline->stop) &&
+           (deadline != 0 || (guint)g_atomic_int_get(&pipeline->head) == pipeline->tail)) {
+        if (deadline == 0) {
+            g_cond_wait(&pipeline->wake, &pipeline->wake_lock);
+        } else if (!g_cond_wait_until(&pipeline->wake, &pipeline->wake_lock, deadline)) {
+            break;
+        }
+    }
+    g_mutex_unlock(&pipeline->wake_lock);
+}
+
+/* Waits for the first event, then keeps collecting for ALERT_BATCH_MS so an outage that hits many targets
+   within a few seconds reaches each sink as one or two deliveries. */
+static gpointer alert_thread(gpointer user_data) {
+    AlertPipeline *pipeline = user_data;
+    GArray *batch = g_array_new(FALSE, FALSE, sizeof(AlertEvent));
+    GHashTable *pending = g_hash_table_new(g_direct_hash, g_direct_equal);
+    GString *lines = g_string_sized_new(4096);
+
+    for (;;) {
+        bool stopping = g_atomic_int_get(&pipeline->stop);
+        collect_events(pipeline, batch, pending);
+        if (batch->len == 0) {
+            if (stopping) {
+                break;
+            }
+            wait_for_events(pipeline, 0);
+            continue;
+        }
+
+        wait_for_events(pipeline, g_get_monotonic_time() + (gint64)ALERT_BATCH_MS * 1000);
+        collect_events(pipeline, batch, pending);
+        deliver_batch(pipeline, batch, lines);
+        g_array_set_size(batch, 0);
+        g_hash_table_remove_all(pending);
+    }
+
+    g_string_free(lines, TRUE);
+    g_hash_table_destroy(pending);
+    g_array_free(batch, TRUE);
+    return NULL;
+}
+
+AlertPipeline *alert_pipeline_new(void) {
+    AlertPipeline *pipeline = g_new0(AlertPipeline, 1);
+    pipeline->slots = g_new(AlertEvent, ALERT_QUEUE_CAPACITY);
+    g_mutex_init(&pipeline->wake_lock);
+    g_cond_init(&pipeline->wake);
+    return pipeline;
+}
+
+bool alert_pipeline_valid_sink(const char *spec) {
+    if (g_str_has_prefix(spec, "exec:") || g_str_has_prefix(spec, "file:")) {
+        return spec[5] != '\0';
+    }
+    return g_str_has_prefix(spec, "http://") || g_str_has_prefix(spec, "https://");
+}
+
+/* Sinks are "exec:<command>", "file:<path>" or an http:// or https:// webhook URL. */
+bool alert_pipeline_add_sink(AlertPipeline *pipeline, const char *spec, char *error, size_t error_size) {
+    if (pipeline->sink_count >= MAX_ALERT_SINKS) {
+        snprintf(error, error_size, "at most %d alert sinks", MAX_ALERT_SINKS);
+        return false;
+    }
+    if (!alert_pipeline_valid_sink(spec)) {
+        snprintf(error, error_size, "expected exec:<command>, file:<path> or an http(s):// URL");
+        return false;
+    }
+
+    AlertSink *sink = &pipeline->sinks[pipeline->sink_count];
+    memset(sink, 0, sizeof(*sink));
+    if (g_str_has_prefix(spec, "exec:")) {
+        sink->type = ALERT_SINK_EXEC;
+        sink->target = g_strdup(spec + 5);
+    } else if (g_str_has_prefix(spec, "file:")) {
+        sink->type = ALERT_SINK_FILE;
+        sink->file = fopen(spec + 5, "a");
+        if (sink->file == NULL) {
+            snprintf(error, error_size, "%s", strerror(errno));
+            return false;
+        }
+        sink->target = g_strdup(spec + 5);
+    } else {
+        sink->type = ALERT_SINK_WEBHOOK;
+        sink->target = g_strdup(spec);
+    }
+    pipeline->sink_count++;
+    return true;
+}
+
+void alert_pipeline_start(AlertPipeline *pipeline) {
+    if (pipeline->thread == NULL && pipeline->sink_count > 0) {
+        pipeline->thread = g_thread_new("netpulse-alerts", alert_thread, pipeline);
+    }
+}
+
+/* Main loop only. */
+bool alert_pipeline_push(AlertPipeline *pipeline, const AlertEvent *event) {
+    guint head = pipeline->head;
+    if (head - (guint)g_atomic_int_get(&pipeline->tail) >= ALERT_QUEUE_CAPACITY) {
+        g_atomic_int_inc(&pipeline->counters.dropped);
+        return false;
+    }
+    pipeline->slots[head & (ALERT_QUEUE_CAPACITY - 1)] = *event;
+    g_atomic_int_set(&pipeline->head, head + 1);
+    g_atomic_int_inc(&pipeline->counters.queued);
+    if ((guint)g_atomic_int_get(&pipeline->tail) == head && pipeline->thread != NULL) {
+        wake_sink_thread(pipeline);
+    }
+    return true;
+}
+
+void alert_pipeline_counters(AlertPipeline *pipeline, AlertCounters *counters) {
+    counters->queued = (guint)g_atomic_int_get(&pipeline->counters.queued);
+    counters->dropped = (guint)g_atomic_int_get(&pipeline->counters.dropped);
+    counters->coalesced = (guint)g_atomic_int_get(&pipeline->counters.coalesced);
+    counters->batches = (guint)g_atomic_int_get(&pipeline->counters.batches);
+    counters->failures = (guint)g_atomic_int_get(&pipeline->counters.failures);
+}
+
+/* Delivers whatever is still queued before returning. */
+void alert_pipeline_free(AlertPipeline *pipeline) {
+    if (pipeline == NULL) {
+        return;
+    }
+    if (pipeline->thread != NULL) {
+        g_atomic_int_set(&pipeline->stop, 1);
+        wake_sink_thread(pipeline);
+        g_thread_join(pipeline->thread);
+    }
+    for (int i = 0; i < pipeline->sink_count; ++i) {
+        AlertSink *sink = &pipeline->sinks[i];
+        if (sink->file != NULL) {
+            fclose(sink->file);
+        }
+        if (sink->curl != NULL) {
+            curl_easy_cleanup(sink->curl);
+            curl_slist_free_all(sink->headers);
+        }
+        g_free(sink->target);
+    }
+    g_cond_clear(&pipeline->wake);
+    g_mutex_clear(&pipeline->wake_lock);
+    g_free(pipeline->slots);
+    g_free(pipeline);
+}
@@ -0,0 +1,65 @@
+#ifndef NETPULSE_ALERTS_H
+#define NETPULSE_ALERTS_H
+
+#include <glib.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define ALERT_QUEUE_CAPACITY 2048
+#define ALERT_BATCH_MS 2000
+#define ALERT_WEBHOOK_TIMEOUT_MS 5000
+#define MAX_ALERT_SINKS 4
+
+/* Flap score: every status change adds 1 and the score halves every FLAP_HALF_LIFE_SEC. A target starts
+   flapping above FLAP_START_SCORE and only stops once the score falls below FLAP_STOP_SCORE, so one more
+   change right at the threshold does not toggle it. */
+#define FLAP_HALF_LIFE_SEC 60.0
+#define FLAP_START_SCORE 4.0
+#define FLAP_STOP_SCORE 1.5
+
+typedef enum {
+    ALERT_TRANSITION,
+    ALERT_FLAP_START,
+    ALERT_FLAP_END,
+} AlertKind;
+
+typedef struct {
+    double score;
+    int64_t updated_ns;
+    bool active;
+} FlapState;
+
+typedef struct {
+    AlertKind kind;
+    unsigned int target_id;
+    char target[256];
+    char host[256];
+    char from[8];
+    char to[8];
+    double timestamp;
+    double latency_ms;
+    bool has_latency;
+} AlertEvent;
+
+typedef struct {
+    guint queued;
+    guint dropped;
+    guint coalesced;
+    guint batches;
+    guint failures;
+} AlertCounters;
+
+typedef struct AlertPipeline AlertPipeline;
+
+int flap_state_update(FlapState *state, int64_t now_ns, bool changed);
+
+AlertPipeline *alert_pipeline_new(void);
+bool alert_pipeline_add_sink(AlertPipeline *pipeline, const char *spec, char *error, size_t error_size);
+bool alert_pipeline_valid_sink(const char *spec);
+void alert_pipeline_start(AlertPipeline *pipeline);
+bool alert_pipeline_push(AlertPipeline *pipeline, const AlertEvent *event);
+void alert_pipeline_counters(AlertPipeline *pipeline, AlertCounters *counters);
+void alert_pipeline_free(AlertPipeline *pipeline);
+
+#endif
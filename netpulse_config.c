@@ -0,0 +1,138 @@
+#define _GNU_SOURCE
+#include "netpulse_config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <glib-unix.h>
+#include <glib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+struct ConfigWatch {
+    int fd;
+    guint source_id;
+    guint debounce_id;
+    int debounce_ms;
+    char *name;
+    ConfigChangedFunc changed;
+    void *user_data;
+};
+
+/* Reads the file in large chunks and hands complete lines straight out of the chunk; only a line that
+   straddles two chunks is copied, so lines have no length limit and a large file costs one pass. */
+bool config_read_lines(const char *path, ConfigLineFunc func, void *user_data) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+
+    char *chunk = g_malloc(CONFIG_READ_CHUNK);
+    GString *pending = g_string_new(NULL);
+    bool ok = true;
+    for (;;) {
+        ssize_t got = read(fd, chunk, CONFIG_READ_CHUNK);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            ok = got == 0;
+            break;
+        }
+
+        char *p = chunk;
+        char *end = chunk + got;
+        char *newline;
+        while ((newline = memchr(p, '\n', (size_t)(end - p))) != NULL) {
+            *newline = '\0';
+            if (pending->len > 0) {
+                g_string_append_len(pending, p, newline - p);
+                func(pending->str, user_data);
+                g_string_truncate(pending, 0);
+            } else {
+                func(p, user_data);
+            }
+            p = newline + 1;
+        }
+        g_string_append_len(pending, p, end - p);
+    }
+    if (ok && pending->len > 0) {
+        func(pending->str, user_data);
+    }
+
+    g_string_free(pending, TRUE);
+    g_free(chunk);
+    close(fd);
+    return ok;
+}
+
+static gboolean on_debounce_elapsed(gpointer user_data) {
+    ConfigWatch *watch = user_data;
+    watch->debounce_id = 0;
+    watch->changed(watch->user_data);
+    return G_SOURCE_REMOVE;
+}
+
+/* Editors either rewrite the file in place or rename a new copy over it, so the directory is watched and
+   events are filtered by name. A save often arrives as several events; each one restarts the debounce. */
+static gboolean on_watch_readable(gint fd, GIOCondition condition, gpointer user_data) {
+    (void)condition;
+    ConfigWatch *watch = user_data;
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    bool matched = false;
+    ssize_t got;
+    while ((got = read(fd, buffer, sizeof(buffer))) > 0) {
+        for (char *p = buffer; p < buffer + got;) {
+            const struct inotify_event *event = (const struct inotify_event *)p;
+            if (event->len > 0 && strcmp(event->name, watch->name) == 0) {
+                matched = true;
+            }
+            p += sizeof(struct inotify_event) + event->len;
+        }
+    }
+
+    if (matched) {
+        if (watch->debounce_id != 0) {
+            g_source_remove(watch->debounce_id);
+        }
+        watch->debounce_id = g_timeout_add(watch->debounce_ms, on_debounce_elapsed, watch);
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+ConfigWatch *config_watch_new(const char *path, int debounce_ms, ConfigChangedFunc changed, void *user_data) {
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    gchar *dir = g_path_get_dirname(path);
+    int wd = inotify_add_watch(fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO);
+    g_free(dir);
+    if (wd < 0) {
+        close(fd);
+        return NULL;
+    }
+
+    ConfigWatch *watch = g_new0(ConfigWatch, 1);
+    watch->fd = fd;
+    watch->debounce_ms = debounce_ms;
+    watch->name = g_path_get_basename(path);
+    watch->changed = changed;
+    watch->user_data = user_data;
+    watch->source_id = g_unix_fd_add(fd, G_IO_IN, on_watch_readable, watch);
+    return watch;
+}
+
+void config_watch_free(ConfigWatch *watch) {
+    if (watch == NULL) {
+        return;
+    }
+    g_source_remove(watch->source_id);
+    if (watch->debounce_id != 0) {
+        g_source_remove(watch->debounce_id);
+    }
+    close(watch->fd);
+    g_free(watch->name);
+    g_free(watch);
+}
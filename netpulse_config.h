@@ -0,0 +1,20 @@
+#ifndef NETPULSE_CONFIG_H
+#define NETPULSE_CONFIG_H
+
+#include <stdbool.h>
+
+#define CONFIG_READ_CHUNK (64 * 1024)
+#define CONFIG_RELOAD_DEBOUNCE_MS 500
+
+/* Called once per line with the trailing newline replaced by a NUL; the line may be modified in place. */
+typedef void (*ConfigLineFunc)(char *line, void *user_data);
+typedef void (*ConfigChangedFunc)(void *user_data);
+
+typedef struct ConfigWatch ConfigWatch;
+
+bool config_read_lines(const char *path, ConfigLineFunc func, void *user_data);
+
+ConfigWatch *config_watch_new(const char *path, int debounce_ms, ConfigChangedFunc changed, void *user_data);
+void config_watch_free(ConfigWatch *watch);
+
+#endif
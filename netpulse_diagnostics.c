@@ -0,0 +1,62 @@
+#include "netpulse_diagnostics.h"
+
+static int bucket_for(uint64_t us) {
+    int bucket = us == 0 ? 0 : 64 - __builtin_clzll(us);
+    return bucket < DURATION_BUCKETS ? bucket : DURATION_BUCKETS - 1;
+}
+
+void duration_histogram_add(DurationHistogram *histogram, int64_t duration_ns) {
+    uint64_t us = duration_ns > 0 ? (uint64_t)duration_ns / 1000 : 0;
+    histogram->counts[bucket_for(us)]++;
+    histogram->total++;
+    histogram->sum_us += us;
+    if (us > histogram->max_us) {
+        histogram->max_us = us;
+    }
+}
+
+double duration_bucket_bound_ms(int bucket) {
+    return (double)((uint64_t)1 << bucket) / 1000.0;
+}
+
+uint64_t duration_histogram_count_below(const DurationHistogram *histogram, int bucket) {
+    uint64_t count = 0;
+    for (int b = 0; b <= bucket && b < DURATION_BUCKETS; ++b) {
+        count += histogram->counts[b];
+    }
+    return count;
+}
+
+/* Returns the upper bound of the bucket holding the quantile, capped at the largest sample seen, or -1
+   without samples. */
+double duration_histogram_quantile_ms(const DurationHistogram *histogram, double quantile) {
+    if (histogram->total == 0) {
+        return -1.0;
+    }
+    uint64_t rank = (uint64_t)(quantile * (double)(histogram->total - 1)) + 1;
+    uint64_t seen = 0;
+    double max_ms = (double)histogram->max_us / 1000.0;
+    for (int bucket = 0; bucket < DURATION_BUCKETS; ++bucket) {
+        seen += histogram->counts[bucket];
+        if (seen >= rank) {
+            double bound = duration_bucket_bound_ms(bucket);
+            return bound < max_ms ? bound : max_ms;
+        }
+    }
+    return max_ms;
+}
+
+const char *probe_kind_name(ProbeKind kind) {
+    switch (kind) {
+    case PROBE_KIND_ICMP:
+        return "icmp";
+    case PROBE_KIND_PING:
+        return "ping";
+    case PROBE_KIND_TCP:
+        return "tcp";
+    case PROBE_KIND_HTTP:
+        return "http";
+    default:
+        return "backend";
+    }
+}
@@ -0,0 +1,42 @@
+#ifndef NETPULSE_DIAGNOSTICS_H
+#define NETPULSE_DIAGNOSTICS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define DURATION_BUCKETS 32
+
+typedef enum {
+    PROBE_KIND_ICMP,
+    PROBE_KIND_PING,
+    PROBE_KIND_TCP,
+    PROBE_KIND_HTTP,
+    PROBE_KIND_BACKEND,
+    PROBE_KIND_COUNT,
+} ProbeKind;
+
+/* Power-of-two buckets in microseconds: bucket b holds durations below 2^b us, the last one everything
+   longer. Adding a sample is a bit scan and three increments, cheap enough to leave on. */
+typedef struct {
+    uint64_t counts[DURATION_BUCKETS];
+    uint64_t total;
+    uint64_t sum_us;
+    uint64_t max_us;
+} DurationHistogram;
+
+/* Owned by the main loop: the tick, dispatch and record paths all update it without locks. */
+typedef struct {
+    DurationHistogram tick;
+    DurationHistogram dispatch[PROBE_KIND_COUNT];
+    DurationHistogram completion[PROBE_KIND_COUNT];
+    int in_flight[PROBE_KIND_COUNT];
+    int64_t last_tick_ns;
+} MonitorDiagnostics;
+
+void duration_histogram_add(DurationHistogram *histogram, int64_t duration_ns);
+double duration_histogram_quantile_ms(const DurationHistogram *histogram, double quantile);
+uint64_t duration_histogram_count_below(const DurationHistogram *histogram, int bucket);
+double duration_bucket_bound_ms(int bucket);
+const char *probe_kind_name(ProbeKind kind);
+
+#endif
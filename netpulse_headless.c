@@ -0,0 +1,234 @@
+#define _POSIX_C_SOURCE 200809L
+#include "netpulse_headless.h"
+
+#include <glib-unix.h>
+#include <signal.h>
+#include <stdio.h>
+
+typedef struct {
+    Monitor monitor;
+    GMainLoop *loop;
+    GString *line;
+} Headless;
+
+static void begin_event(Headless *headless, const char *event) {
+    g_string_truncate(headless->line, 0);
+    g_string_append_printf(headless->line, "{\"event\":\"%s\",\"ts\":%.3f", event, g_get_real_time() / 1e6);
+}
+
+static void end_event(Headless *headless) {
+    g_string_append(headless->line, "}\n");
+    fwrite(headless->line->str, 1, headless->line->len, stdout);
+}
+
+static void append_number_or_null(GString *out, const char *key, double value, bool present) {
+    if (present) {
+        g_string_append_printf(out, ",\"%s\":%.3f", key, value);
+    } else {
+        g_string_append_printf(out, ",\"%s\":null", key);
+    }
+}
+
+static void append_target_fields(GString *out, const Target *target) {
+    g_string_append_printf(out, ",\"id\":%u,\"target\":", target->id);
+    append_json_string(out, target->display);
+    g_string_append(out, ",\"host\":");
+    append_json_string(out, target->host);
+    g_string_append(out, ",\"status\":");
+    append_json_string(out, target->status);
+}
+
+static void append_tail_fields(GString *out, Target *target) {
+    TargetWindowStats stats;
+    target_window_stats(target, &stats);
+    append_number_or_null(out, "p50_ms", stats.p50_ms, stats.p50_ms >= 0.0);
+    append_number_or_null(out, "p95_ms", stats.p95_ms, stats.p95_ms >= 0.0);
+    append_number_or_null(out, "p99_ms", stats.p99_ms, stats.p99_ms >= 0.0);
+    append_number_or_null(out, "jitter_ms", stats.jitter_ms, stats.jitter_ms >= 0.0);
+}
+
+static void on_log(const char *timestamp, const char *message, gpointer user_data) {
+    (void)timestamp;
+    Headless *headless = user_data;
+    begin_event(headless, "log");
+    g_string_append(headless->line, ",\"message\":");
+    append_json_string(headless->line, message);
+    end_event(headless);
+    fflush(stdout);
+}
+
+static void on_sample(Target *target, gpointer user_data) {
+    Headless *headless = user_data;
+    begin_event(headless, "sample");
+    append_target_fields(headless->line, target);
+    g_string_append_printf(headless->line, ",\"ok\":%s", target->last_success ? "true" : "false");
+    append_number_or_null(headless->line, "latency_ms", target->last_latency_ms, target->has_latency);
+    append_number_or_null(headless->line, "resolve_ms", target->resolve_ms, target->has_resolve);
+    if (target->has_loss) {
+        append_number_or_null(headless->line, "loss_pct", target->loss_pct, true);
+    }
+    if (target->has_reported_jitter) {
+        append_number_or_null(headless->line, "probe_jitter_ms", target->reported_jitter_ms, true);
+    }
+    if (target->samples > 0) {
+        g_string_append_printf(headless->line, ",\"samples\":%d", target->samples);
+    }
+    if (target->has_latency_range) {
+        append_number_or_null(headless->line, "min_ms", target->latency_min_ms, true);
+        append_number_or_null(headless->line, "max_ms", target->latency_max_ms, true);
+    }
+    if (target->adaptive_ms > 0) {
+        g_string_append_printf(headless->line, ",\"interval_ms\":%d", target->adaptive_ms);
+    }
+    if (target->last_failure != NULL) {
+        g_string_append(headless->line, ",\"failure\":");
+        append_json_string(headless->line, target->last_failure);
+    }
+    if (target->has_phases) {
+        g_string_append(headless->line, ",\"phases\":{");
+        for (int phase = 0; phase < HTTP_PHASE_COUNT; ++phase) {
+            g_string_append_printf(headless->line, "%s\"%s_ms\":%.3f", phase > 0 ? "," : "",
+                                   http_phase_name((HttpPhase)phase), target->phase_ms[phase]);
+        }
+        g_string_append_c(headless->line, '}');
+    }
+    append_tail_fields(headless->line, target);
+    end_event(headless);
+}
+
+static void on_updated(gpointer user_data) {
+    (void)user_data;
+    fflush(stdout);
+}
+
+static void append_quantile_field(GString *out, const char *key, const DurationHistogram *histogram,
+                                  double quantile) {
+    double value = duration_histogram_quantile_ms(histogram, quantile);
+    append_number_or_null(out, key, value, value >= 0.0);
+}
+
+static void emit_diagnostics(Headless *headless) {
+    const Monitor *monitor = &headless->monitor;
+    const MonitorCounters *counters = &monitor->counters;
+    GString *line = headless->line;
+    begin_event(headless, "diagnostics");
+    append_quantile_field(line, "tick_p50_ms", &monitor->diag.tick, 0.50);
+    append_quantile_field(line, "tick_p99_ms", &monitor->diag.tick, 0.99);
+    append_number_or_null(line, "tick_max_ms", (double)monitor->diag.tick.max_us / 1000.0, true);
+    g_string_append_printf(line,
+                           ",\"ticks_overrun\":%" G_GUINT64_FORMAT ",\"ticks_late\":%" G_GUINT64_FORMAT
+                           ",\"ticks_missed\":%" G_GUINT64_FORMAT ",\"probes_skipped\":%" G_GUINT64_FORMAT
+                           ",\"spawn_errors\":%" G_GUINT64_FORMAT ",\"socket_errors\":%" G_GUINT64_FORMAT,
+                           counters->ticks_overrun, counters->ticks_late, counters->ticks_missed,
+                           counters->probes_skipped, counters->spawn_errors, counters->socket_errors);
+    g_string_append(line, ",\"probes\":{");
+    for (int kind = 0; kind < PROBE_KIND_COUNT; ++kind) {
+        g_string_append_printf(line, "%s\"%s\":{\"in_flight\":%d", kind > 0 ? "," : "",
+                               probe_kind_name((ProbeKind)kind), monitor->diag.in_flight[kind]);
+        append_quantile_field(line, "dispatch_p50_ms", &monitor->diag.dispatch[kind], 0.50);
+        append_quantile_field(line, "dispatch_p99_ms", &monitor->diag.dispatch[kind], 0.99);
+        append_quantile_field(line, "completion_p50_ms", &monitor->diag.completion[kind], 0.50);
+        append_quantile_field(line, "completion_p99_ms", &monitor->diag.completion[kind], 0.99);
+        g_string_append_c(line, '}');
+    }
+    g_string_append_c(line, '}');
+    end_event(headless);
+}
+
+static gboolean on_summary_signal(gpointer user_data) {
+    Headless *headless = user_data;
+    TargetStore *store = &headless->monitor.targets;
+    for (size_t i = 0; i < target_store_count(store); ++i) {
+        Target *target = target_store_at(store, i);
+        TargetWindowStats stats;
+        target_window_stats(target, &stats);
+
+        begin_event(headless, "summary");
+        append_target_fields(headless->line, target);
+        g_string_append_printf(headless->line, ",\"samples60\":%d", stats.samples);
+        append_number_or_null(headless->line, "avg60_ms", stats.avg_latency_ms, stats.avg_latency_ms >= 0.0);
+        append_number_or_null(headless->line, "uptime60_pct", stats.uptime_pct, stats.uptime_pct >= 0.0);
+        g_string_append_printf(headless->line, ",\"window_sec\":%d", stats.window_sec);
+        append_tail_fields(headless->line, target);
+        RollupStats day;
+        RollupStats month;
+        target_rollup_stats(target, time(NULL), 86400, false, &day);
+        target_rollup_stats(target, time(NULL), 30 * 86400, false, &month);
+        append_number_or_null(headless->line, "uptime24h_pct", day.uptime_pct, day.uptime_pct >= 0.0);
+        append_number_or_null(headless->line, "p95_24h_ms", day.p95_ms, day.p95_ms >= 0.0);
+        append_number_or_null(headless->line, "uptime30d_pct", month.uptime_pct, month.uptime_pct >= 0.0);
+        append_number_or_null(headless->line, "p95_30d_ms", month.p95_ms, month.p95_ms >= 0.0);
+        end_event(headless);
+    }
+    emit_diagnostics(headless);
+    fflush(stdout);
+    return G_SOURCE_CONTINUE;
+}
+
+static gboolean on_quit_signal(gpointer user_data) {
+    Headless *headless = user_data;
+    monitor_log(&headless->monitor, "Shutdown requested.");
+    g_main_loop_quit(headless->loop);
+    return G_SOURCE_CONTINUE;
+}
+
+/* Runs the main loop until SIGINT or SIGTERM. An aggregator without local targets only records what its
+   agents send. */
+static void run_until_quit(Headless *headless) {
+    guint sigint_id = g_unix_signal_add(SIGINT, on_quit_signal, headless);
+    guint sigterm_id = g_unix_signal_add(SIGTERM, on_quit_signal, headless);
+    guint sigusr1_id = g_unix_signal_add(SIGUSR1, on_summary_signal, headless);
+
+    if (target_store_count(&headless->monitor.targets) > 0) {
+        monitor_start(&headless->monitor);
+    }
+    g_main_loop_run(headless->loop);
+
+    g_source_remove(sigint_id);
+    g_source_remove(sigterm_id);
+    g_source_remove(sigusr1_id);
+}
+
+int headless_run(const MonitorOptions *options) {
+    Headless *headless = g_new0(Headless, 1);
+    headless->line = g_string_sized_new(512);
+    headless->loop = g_main_loop_new(NULL, FALSE);
+
+    MonitorCallbacks callbacks = {
+        .log = on_log,
+        .sample = on_sample,
+        .updated = on_updated,
+        .user_data = headless,
+    };
+    monitor_init(&headless->monitor, &callbacks);
+    monitor_configure(&headless->monitor, options);
+
+    int exit_code = 0;
+    bool aggregating = headless->monitor.relay_receiver != NULL;
+    if (target_store_count(&headless->monitor.targets) == 0 && !aggregating) {
+        monitor_log(&headless->monitor, "No targets configured; pass targets or -f <file>.");
+        exit_code = 1;
+    } else {
+        run_until_quit(headless);
+    }
+
+    monitor_shutdown(&headless->monitor);
+    fflush(stdout);
+
+    g_main_loop_unref(headless->loop);
+    g_string_free(headless->line, TRUE);
+    g_free(headless);
+    return exit_code;
+}
+
+#ifdef NETPULSE_HEADLESS_MAIN
+int main(int argc, char **argv) {
+    MonitorOptions options;
+    int exit_code = monitor_parse_options(&options, argc, argv);
+    if (exit_code >= 0) {
+        return exit_code;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    return headless_run(&options);
+}
+#endif
@@ -0,0 +1,8 @@
+#ifndef NETPULSE_HEADLESS_H
+#define NETPULSE_HEADLESS_H
+
+#include "netpulse_monitor.h"
+
+int headless_run(const MonitorOptions *options);
+
+#endif
@@ -0,0 +1,266 @@
+#define _DEFAULT_SOURCE
+#include "netpulse_history.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define HISTORY_FILE_MAGIC "NPHIST01"
+#define HISTORY_FILE_VERSION 1
+#define HISTORY_FILE_INITIAL_SLOTS 64
+
+#define RECORD_VALID 0x1u
+#define RECORD_SUCCESS 0x2u
+#define RECORD_HAS_LATENCY 0x4u
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t records_per_slot;
+    uint32_t slot_size;
+    uint32_t slot_count;
+} FileHeader;
+
+/* A record is only trusted when its checksum matches, so a record torn by a
+   crash or power loss is skipped on reload instead of read as garbage. */
+typedef struct {
+    uint64_t seq;
+    int64_t timestamp;
+    double latency_ms;
+    uint32_t flags;
+    uint32_t checksum;
+} FileRecord;
+
+typedef struct {
+    char host[HISTORY_FILE_HOST_SIZE];
+    uint32_t host_checksum;
+    uint32_t reserved;
+    uint64_t next_seq;
+    FileRecord records[HISTORY_FILE_RECORDS];
+} FileSlot;
+
+#define HEADER_SIZE 64
+
+static uint32_t fnv1a(const void *data, size_t len) {
+    const unsigned char *p = data;
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; ++i) {
+        hash ^= p[i];
+        hash *= 16777619u;
+    }
+    return hash != 0 ? hash : 1;
+}
+
+static uint32_t record_checksum(const FileRecord *record) {
+    return fnv1a(record, offsetof(FileRecord, checksum));
+}
+
+static FileHeader *file_header(const HistoryFile *file) {
+    return (FileHeader *)file->map;
+}
+
+static FileSlot *file_slot(const HistoryFile *file, uint32_t slot) {
+    return (FileSlot *)(file->map + HEADER_SIZE + (size_t)slot * sizeof(FileSlot));
+}
+
+static bool slot_in_use(const FileSlot *slot) {
+    return slot->host_checksum != 0 && slot->host_checksum == fnv1a(slot->host, sizeof(slot->host));
+}
+
+static size_t file_size_for(uint32_t slot_count) {
+    return HEADER_SIZE + (size_t)slot_count * sizeof(FileSlot);
+}
+
+static bool map_file(HistoryFile *file, size_t size) {
+    void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, file->fd, 0);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+    file->map = map;
+    file->map_size = size;
+    return true;
+}
+
+static bool grow_file(HistoryFile *file, uint32_t slot_count) {
+    size_t size = file_size_for(slot_count);
+    if (ftruncate(file->fd, (off_t)size) != 0) {
+        return false;
+    }
+    if (file->map != NULL) {
+        munmap(file->map, file->map_size);
+        file->map = NULL;
+    }
+    if (!map_file(file, size)) {
+        return false;
+    }
+    /* The header is updated last, so a crash mid-grow leaves a valid, merely oversized file. */
+    file_header(file)->slot_count = slot_count;
+    file->slot_count = slot_count;
+    return true;
+}
+
+bool history_file_open(HistoryFile *file, const char *path) {
+    memset(file, 0, sizeof(*file));
+    file->fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (file->fd < 0) {
+        return false;
+    }
+    if (flock(file->fd, LOCK_EX | LOCK_NB) != 0) {
+        close(file->fd);
+        file->fd = -1;
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(file->fd, &st) != 0) {
+        history_file_close(file);
+        return false;
+    }
+
+    if (st.st_size == 0) {
+        if (!grow_file(file, HISTORY_FILE_INITIAL_SLOTS)) {
+            history_file_close(file);
+            return false;
+        }
+        FileHeader *header = file_header(file);
+        header->version = HISTORY_FILE_VERSION;
+        header->records_per_slot = HISTORY_FILE_RECORDS;
+        header->slot_size = sizeof(FileSlot);
+        memcpy(header->magic, HISTORY_FILE_MAGIC, sizeof(header->magic));
+        msync(file->map, file->map_size, MS_SYNC);
+        return true;
+    }
+
+    if ((size_t)st.st_size < HEADER_SIZE || !map_file(file, (size_t)st.st_size)) {
+        history_file_close(file);
+        return false;
+    }
+    const FileHeader *header = file_header(file);
+    if (memcmp(header->magic, HISTORY_FILE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != HISTORY_FILE_VERSION || header->records_per_slot != HISTORY_FILE_RECORDS ||
+        header->slot_size != sizeof(FileSlot)) {
+        history_file_close(file);
+        return false;
+    }
+
+    file->slot_count = header->slot_count;
+    size_t fits = (file->map_size - HEADER_SIZE) / sizeof(FileSlot);
+    if (file->slot_count > fits) {
+        file->slot_count = (uint32_t)fits;
+    }
+    return true;
+}
+
+void history_file_close(HistoryFile *file) {
+    if (file->map != NULL) {
+        msync(file->map, file->map_size, MS_SYNC);
+        munmap(file->map, file->map_size);
+        file->map = NULL;
+    }
+    if (file->fd >= 0) {
+        close(file->fd);
+        file->fd = -1;
+    }
+    file->slot_count = 0;
+}
+
+void history_file_sync(HistoryFile *file, bool wait) {
+    if (file->map != NULL) {
+        msync(file->map, file->map_size, wait ? MS_SYNC : MS_ASYNC);
+    }
+}
+
+const char *history_file_slot_host(const HistoryFile *file, uint32_t slot) {
+    if (slot >= file->slot_count) {
+        return NULL;
+    }
+    const FileSlot *s = file_slot(file, slot);
+    return slot_in_use(s) ? s->host : NULL;
+}
+
+int history_file_claim(HistoryFile *file, const char *host) {
+    uint32_t slot = file->slot_count;
+    for (uint32_t n = 0; n < file->slot_count; ++n) {
+        uint32_t candidate = (file->free_cursor + n) % file->slot_count;
+        if (!slot_in_use(file_slot(file, candidate))) {
+            slot = candidate;
+            break;
+        }
+    }
+    uint32_t grown = file->slot_count > 0 ? file->slot_count * 2 : HISTORY_FILE_INITIAL_SLOTS;
+    if (slot == file->slot_count && !grow_file(file, grown)) {
+        return -1;
+    }
+
+    FileSlot *s = file_slot(file, slot);
+    memset(s, 0, sizeof(*s));
+    snprintf(s->host, sizeof(s->host), "%s", host);
+    s->host_checksum = fnv1a(s->host, sizeof(s->host));
+    file->free_cursor = (slot + 1) % file->slot_count;
+    return (int)slot;
+}
+
+void history_file_release(HistoryFile *file, uint32_t slot) {
+    if (slot >= file->slot_count) {
+        return;
+    }
+    memset(file_slot(file, slot), 0, sizeof(FileSlot));
+}
+
+void history_file_append(HistoryFile *file, uint32_t slot, int64_t timestamp, bool success, double latency_ms,
+                         bool has_latency) {
+    if (slot >= file->slot_count) {
+        return;
+    }
+    FileSlot *s = file_slot(file, slot);
+    FileRecord *record = &s->records[s->next_seq % HISTORY_FILE_RECORDS];
+    record->checksum = 0;
+    record->seq = s->next_seq;
+    record->timestamp = timestamp;
+    record->latency_ms = has_latency ? latency_ms : -1.0;
+    record->flags = RECORD_VALID | (success ? RECORD_SUCCESS : 0) | (has_latency ? RECORD_HAS_LATENCY : 0);
+    record->checksum = record_checksum(record);
+    s->next_seq++;
+}
+
+/* Returns the slot's valid records oldest first. The slot's next_seq is
+   rebuilt from the records themselves, since it may lag a record written
+   just before a crash. */
+size_t history_file_replay(HistoryFile *file, uint32_t slot, HistoryRecord *records, size_t max_records) {
+    if (slot >= file->slot_count) {
+        return 0;
+    }
+    FileSlot *s = file_slot(file, slot);
+
+    const FileRecord *valid[HISTORY_FILE_RECORDS];
+    size_t count = 0;
+    for (size_t i = 0; i < HISTORY_FILE_RECORDS; ++i) {
+        const FileRecord *record = &s->records[i];
+        if ((record->flags & RECORD_VALID) == 0 || record->checksum != record_checksum(record) ||
+            record->seq % HISTORY_FILE_RECORDS != i) {
+            continue;
+        }
+        size_t j = count++;
+        while (j > 0 && valid[j - 1]->seq > record->seq) {
+            valid[j] = valid[j - 1];
+            j--;
+        }
+        valid[j] = record;
+    }
+
+    s->next_seq = count > 0 ? valid[count - 1]->seq + 1 : 0;
+
+    size_t first = count > max_records ? count - max_records : 0;
+    for (size_t i = first; i < count; ++i) {
+        HistoryRecord *out = &records[i - first];
+        out->timestamp = valid[i]->timestamp;
+        out->latency_ms = valid[i]->latency_ms;
+        out->success = (valid[i]->flags & RECORD_SUCCESS) != 0;
+        out->has_latency = (valid[i]->flags & RECORD_HAS_LATENCY) != 0;
+    }
+    return count - first;
+}
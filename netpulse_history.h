@@ -0,0 +1,38 @@
+#ifndef NETPULSE_HISTORY_H
+#define NETPULSE_HISTORY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define HISTORY_FILE_RECORDS 120
+#define HISTORY_FILE_HOST_SIZE 256
+
+typedef struct {
+    int fd;
+    unsigned char *map;
+    size_t map_size;
+    uint32_t slot_count;
+    uint32_t free_cursor;
+} HistoryFile;
+
+typedef struct {
+    int64_t timestamp;
+    double latency_ms;
+    bool success;
+    bool has_latency;
+} HistoryRecord;
+
+bool history_file_open(HistoryFile *file, const char *path);
+void history_file_close(HistoryFile *file);
+void history_file_sync(HistoryFile *file, bool wait);
+
+const char *history_file_slot_host(const HistoryFile *file, uint32_t slot);
+int history_file_claim(HistoryFile *file, const char *host);
+void history_file_release(HistoryFile *file, uint32_t slot);
+
+void history_file_append(HistoryFile *file, uint32_t slot, int64_t timestamp, bool success, double latency_ms,
+                         bool has_latency);
+size_t history_file_replay(HistoryFile *file, uint32_t slot, HistoryRecord *records, size_t max_records);
+
+#endif
@@ -0,0 +1,407 @@
+#include "netpulse_http.h"
+
+#include <curl/curl.h>
+#include <glib-unix.h>
+#include <stdio.h>
+#include <string.h>
+
+#define HTTP_CONNECT_TIMEOUT_MS 1000
+#define HTTP_MAX_HOST_CONNECTIONS 4
+#define HTTP_IDLE_HANDLES 64
+
+typedef struct {
+    HttpClient *client;
+    CURL *easy;
+    GString *body;
+    GString *headers;
+    struct curl_slist *request_headers;
+    char error[CURL_ERROR_SIZE];
+    HttpChunkFunc chunk;
+    HttpDoneFunc done;
+    gpointer user_data;
+    GList link;
+} HttpRequest;
+
+typedef struct {
+    guint source_id;
+    int action;
+    GList link;
+} SocketWatch;
+
+/* Started requests and socket watches are kept in queues so that freeing the client can end them. */
+struct HttpClient {
+    CURLM *multi;
+    guint timer_id;
+    guint in_flight;
+    GPtrArray *idle_handles;
+    GQueue active;
+    GQueue watches;
+};
+
+static void check_completed(HttpClient *client);
+
+static size_t on_body(char *data, size_t size, size_t nmemb, void *user_data) {
+    HttpRequest *request = user_data;
+    if (request->chunk != NULL) {
+        request->chunk(data, size * nmemb, request->user_data);
+    } else {
+        g_string_append_len(request->body, data, (gssize)(size * nmemb));
+    }
+    return size * nmemb;
+}
+
+static size_t on_header(char *data, size_t size, size_t nmemb, void *user_data) {
+    HttpRequest *request = user_data;
+    size_t len = size * nmemb;
+    if (len >= 5 && strncmp(data, "HTTP/", 5) == 0) {
+        g_string_truncate(request->headers, 0);
+    }
+    g_string_append_len(request->headers, data, (gssize)len);
+    return len;
+}
+
+static gboolean on_socket_ready(gint fd, GIOCondition condition, gpointer user_data) {
+    HttpClient *client = user_data;
+    int mask = 0;
+    if (condition & G_IO_IN) {
+        mask |= CURL_CSELECT_IN;
+    }
+    if (condition & G_IO_OUT) {
+        mask |= CURL_CSELECT_OUT;
+    }
+    if (condition & (G_IO_ERR | G_IO_HUP)) {
+        mask |= CURL_CSELECT_ERR;
+    }
+
+    int running = 0;
+    curl_multi_socket_action(client->multi, fd, mask, &running);
+    check_completed(client);
+    return G_SOURCE_CONTINUE;
+}
+
+static int on_socket_update(CURL *easy, curl_socket_t fd, int action, void *user_data, void *socket_data) {
+    (void)easy;
+    HttpClient *client = user_data;
+    SocketWatch *watch = socket_data;
+
+    if (action == CURL_POLL_REMOVE) {
+        if (watch != NULL) {
+            g_source_remove(watch->source_id);
+            g_queue_unlink(&client->watches, &watch->link);
+            g_free(watch);
+            curl_multi_assign(client->multi, fd, NULL);
+        }
+        return 0;
+    }
+
+    if (watch == NULL) {
+        watch = g_new0(SocketWatch, 1);
+        watch->link.data = watch;
+        g_queue_push_tail_link(&client->watches, &watch->link);
+        curl_multi_assign(client->multi, fd, watch);
+    } else if (watch->action == action) {
+        return 0;
+    } else {
+        g_source_remove(watch->source_id);
+    }
+
+    GIOCondition condition = G_IO_ERR | G_IO_HUP;
+    if (action == CURL_POLL_IN || action == CURL_POLL_INOUT) {
+        condition |= G_IO_IN;
+    }
+    if (action == CURL_POLL_OUT || action == CURL_POLL_INOUT) {
+        condition |= G_IO_OUT;
+    }
+    watch->action = action;
+    watch->source_id = g_unix_fd_add(fd, condition, on_socket_ready, client);
+    return 0;
+}
+
+static gboolean on_timeout(gpointer user_data) {
+    HttpClient *client = user_data;
+    client->timer_id = 0;
+
+    int running = 0;
+    curl_multi_socket_action(client->multi, CURL_SOCKET_TIMEOUT, 0, &running);
+    check_completed(client);
+    return G_SOURCE_REMOVE;
+}
+
+static int on_timer_update(CURLM *multi, long timeout_ms, void *user_data) {
+    (void)multi;
+    HttpClient *client = user_data;
+    if (client->timer_id != 0) {
+        g_source_remove(client->timer_id);
+        client->timer_id = 0;
+    }
+    if (timeout_ms >= 0) {
+        client->timer_id = g_timeout_add((guint)timeout_ms, on_timeout, client);
+    }
+    return 0;
+}
+
+static double info_ms(CURL *easy, CURLINFO info) {
+    curl_off_t us = 0;
+    curl_easy_getinfo(easy, info, &us);
+    return (double)us / 1000.0;
+}
+
+/* curl reports cumulative times from the start of the transfer; each phase is the step between them.
+   A reused connection has no lookup, connect or handshake, so those phases come out as zero. */
+static void read_timings(CURL *easy, HttpTimings *timings) {
+    double lookup = info_ms(easy, CURLINFO_NAMELOOKUP_TIME_T);
+    double connect = MAX(info_ms(easy, CURLINFO_CONNECT_TIME_T), lookup);
+    double handshake = MAX(info_ms(easy, CURLINFO_APPCONNECT_TIME_T), connect);
+    double first_byte = MAX(info_ms(easy, CURLINFO_STARTTRANSFER_TIME_T), handshake);
+    timings->phase_ms[HTTP_PHASE_DNS] = lookup;
+    timings->phase_ms[HTTP_PHASE_CONNECT] = connect - lookup;
+    timings->phase_ms[HTTP_PHASE_TLS] = handshake - connect;
+    timings->phase_ms[HTTP_PHASE_TTFB] = first_byte - handshake;
+
+    long new_connections = 0;
+    curl_easy_getinfo(easy, CURLINFO_NUM_CONNECTS, &new_connections);
+    timings->reused = new_connections == 0;
+}
+
+static const char *classify_failure(CURLcode result) {
+    switch (result) {
+    case CURLE_OPERATION_TIMEDOUT:
+        return "timeout";
+    case CURLE_COULDNT_RESOLVE_HOST:
+        return "dns";
+    case CURLE_COULDNT_CONNECT:
+        return "refused";
+    case CURLE_SSL_CONNECT_ERROR:
+    case CURLE_PEER_FAILED_VERIFICATION:
+        return "tls";
+    default:
+        return "error";
+    }
+}
+
+static void release_request(HttpRequest *request) {
+    HttpClient *client = request->client;
+    curl_multi_remove_handle(client->multi, request->easy);
+    g_queue_unlink(&client->active, &request->link);
+    if (client->idle_handles->len < HTTP_IDLE_HANDLES) {
+        curl_easy_reset(request->easy);
+        g_ptr_array_add(client->idle_handles, request->easy);
+    } else {
+        curl_easy_cleanup(request->easy);
+    }
+    curl_slist_free_all(request->request_headers);
+    g_string_free(request->body, TRUE);
+    g_string_free(request->headers, TRUE);
+    g_free(request);
+    client->in_flight--;
+}
+
+static void check_completed(HttpClient *client) {
+    CURLMsg *msg;
+    int queued = 0;
+    while ((msg = curl_multi_info_read(client->multi, &queued)) != NULL) {
+        if (msg->msg != CURLMSG_DONE) {
+            continue;
+        }
+
+        HttpRequest *request = NULL;
+        curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char **)&request);
+
+        HttpResponse response;
+        memset(&response, 0, sizeof(response));
+        curl_easy_getinfo(request->easy, CURLINFO_RESPONSE_CODE, &response.status);
+        double total_sec = 0.0;
+        curl_easy_getinfo(request->easy, CURLINFO_TOTAL_TIME, &total_sec);
+        response.total_ms = total_sec * 1000.0;
+        response.body = request->body->str;
+        response.body_len = request->body->len;
+        response.headers = request->headers->str;
+        read_timings(request->easy, &response.timings);
+        if (msg->data.result != CURLE_OK) {
+            response.error = request->error[0] != '\0' ? request->error : curl_easy_strerror(msg->data.result);
+            response.failure = classify_failure(msg->data.result);
+        } else if (response.status >= 400) {
+            response.error = "HTTP error status";
+            response.failure = "http_status";
+        } else {
+            response.ok = true;
+        }
+
+        request->done(&response, request->user_data);
+        release_request(request);
+    }
+}
+
+HttpClient *http_client_new(void) {
+    static bool global_ready = false;
+    if (!global_ready) {
+        curl_global_init(CURL_GLOBAL_DEFAULT);
+        global_ready = true;
+    }
+
+    HttpClient *client = g_new0(HttpClient, 1);
+    client->multi = curl_multi_init();
+    client->idle_handles = g_ptr_array_new();
+    curl_multi_setopt(client->multi, CURLMOPT_SOCKETFUNCTION, on_socket_update);
+    curl_multi_setopt(client->multi, CURLMOPT_SOCKETDATA, client);
+    curl_multi_setopt(client->multi, CURLMOPT_TIMERFUNCTION, on_timer_update);
+    curl_multi_setopt(client->multi, CURLMOPT_TIMERDATA, client);
+    curl_multi_setopt(client->multi, CURLMOPT_PIPELINING, (long)CURLPIPE_MULTIPLEX);
+    curl_multi_setopt(client->multi, CURLMOPT_MAX_HOST_CONNECTIONS, (long)HTTP_MAX_HOST_CONNECTIONS);
+    return client;
+}
+
+/* Requests still running when the client is freed complete as failed, so their callers can release what they
+   passed as user data. */
+static void cancel_request(HttpRequest *request) {
+    HttpResponse response;
+    memset(&response, 0, sizeof(response));
+    response.body = request->body->str;
+    response.body_len = request->body->len;
+    response.headers = request->headers->str;
+    response.error = "HTTP client closed";
+    response.failure = "cancelled";
+    request->done(&response, request->user_data);
+    release_request(request);
+}
+
+void http_client_free(HttpClient *client) {
+    if (client == NULL) {
+        return;
+    }
+    GList *link;
+    while ((link = g_queue_peek_head_link(&client->active)) != NULL) {
+        cancel_request(link->data);
+    }
+    /* curl may still report idle pooled sockets from curl_multi_cleanup(); the watches are gone by then. */
+    curl_multi_setopt(client->multi, CURLMOPT_SOCKETFUNCTION, NULL);
+    curl_multi_setopt(client->multi, CURLMOPT_TIMERFUNCTION, NULL);
+    while ((link = g_queue_pop_head_link(&client->watches)) != NULL) {
+        SocketWatch *watch = link->data;
+        g_source_remove(watch->source_id);
+        g_free(watch);
+    }
+    if (client->timer_id != 0) {
+        g_source_remove(client->timer_id);
+    }
+    for (guint i = 0; i < client->idle_handles->len; ++i) {
+        curl_easy_cleanup(g_ptr_array_index(client->idle_handles, i));
+    }
+    g_ptr_array_free(client->idle_handles, TRUE);
+    curl_multi_cleanup(client->multi);
+    g_free(client);
+}
+
+static HttpRequest *new_request(HttpClient *client, const char *url, long timeout_ms, HttpDoneFunc done,
+                                gpointer user_data) {
+    HttpRequest *request = g_new0(HttpRequest, 1);
+    request->client = client;
+    request->body = g_string_sized_new(256);
+    request->headers = g_string_sized_new(256);
+    request->done = done;
+    request->user_data = user_data;
+    request->link.data = request;
+    if (client->idle_handles->len > 0) {
+        request->easy = g_ptr_array_remove_index_fast(client->idle_handles, client->idle_handles->len - 1);
+    } else {
+        request->easy = curl_easy_init();
+    }
+
+    CURL *easy = request->easy;
+    curl_easy_setopt(easy, CURLOPT_URL, url);
+    curl_easy_setopt(easy, CURLOPT_PRIVATE, request);
+    curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, on_body);
+    curl_easy_setopt(easy, CURLOPT_WRITEDATA, request);
+    curl_easy_setopt(easy, CURLOPT_HEADERFUNCTION, on_header);
+    curl_easy_setopt(easy, CURLOPT_HEADERDATA, request);
+    curl_easy_setopt(easy, CURLOPT_ERRORBUFFER, request->error);
+    curl_easy_setopt(easy, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(easy, CURLOPT_CONNECTTIMEOUT_MS, (long)HTTP_CONNECT_TIMEOUT_MS);
+    curl_easy_setopt(easy, CURLOPT_TIMEOUT_MS, timeout_ms);
+    curl_easy_setopt(easy, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(easy, CURLOPT_HTTP_VERSION, (long)CURL_HTTP_VERSION_2TLS);
+    curl_easy_setopt(easy, CURLOPT_PIPEWAIT, 1L);
+    return request;
+}
+
+static void start_request(HttpClient *client, HttpRequest *request) {
+    client->in_flight++;
+    g_queue_push_tail_link(&client->active, &request->link);
+    curl_multi_add_handle(client->multi, request->easy);
+}
+
+void http_client_get(HttpClient *client, const char *url, long timeout_ms, HttpDoneFunc done, gpointer user_data) {
+    HttpRequest *request = new_request(client, url, timeout_ms, done, user_data);
+    start_request(client, request);
+}
+
+/* A probe is a HEAD request. Without reuse it opens a fresh connection and skips curl's DNS cache, so
+   every probe measures lookup, connect and handshake; with reuse it rides the pooled keep-alive connections. */
+void http_client_probe(HttpClient *client, const char *url, long timeout_ms, bool reuse, HttpDoneFunc done,
+                       gpointer user_data) {
+    HttpRequest *request = new_request(client, url, timeout_ms, done, user_data);
+    CURL *easy = request->easy;
+    curl_easy_setopt(easy, CURLOPT_NOBODY, 1L);
+    curl_easy_setopt(easy, CURLOPT_CONNECTTIMEOUT_MS, timeout_ms);
+    if (!reuse) {
+        curl_easy_setopt(easy, CURLOPT_FRESH_CONNECT, 1L);
+        curl_easy_setopt(easy, CURLOPT_FORBID_REUSE, 1L);
+        curl_easy_setopt(easy, CURLOPT_DNS_CACHE_TIMEOUT, 0L);
+        curl_easy_setopt(easy, CURLOPT_PIPEWAIT, 0L);
+    }
+    start_request(client, request);
+}
+
+const char *http_phase_name(HttpPhase phase) {
+    static const char *names[HTTP_PHASE_COUNT] = {"dns", "connect", "tls", "ttfb"};
+    return phase < HTTP_PHASE_COUNT ? names[phase] : "unknown";
+}
+
+void http_client_post(HttpClient *client, const char *url, const char *content_type, const char *body, size_t body_len,
+                      long timeout_ms, HttpChunkFunc chunk, HttpDoneFunc done, gpointer user_data) {
+    HttpRequest *request = new_request(client, url, timeout_ms, done, user_data);
+    request->chunk = chunk;
+
+    char content_header[128];
+    snprintf(content_header, sizeof(content_header), "Content-Type: %s", content_type);
+    request->request_headers = curl_slist_append(request->request_headers, content_header);
+    request->request_headers = curl_slist_append(request->request_headers, "Expect:");
+    curl_easy_setopt(request->easy, CURLOPT_HTTPHEADER, request->request_headers);
+    curl_easy_setopt(request->easy, CURLOPT_POSTFIELDSIZE, (long)body_len);
+    curl_easy_setopt(request->easy, CURLOPT_COPYPOSTFIELDS, body);
+    start_request(client, request);
+}
+
+bool http_response_header(const HttpResponse *response, const char *name, char *value, size_t value_size) {
+    if (response->headers == NULL) {
+        return false;
+    }
+
+    size_t name_len = strlen(name);
+    const char *line = response->headers;
+    while (*line != '\0') {
+        const char *end = strchr(line, '\n');
+        size_t line_len = end != NULL ? (size_t)(end - line) : strlen(line);
+        if (line_len > name_len && line[name_len] == ':' && g_ascii_strncasecmp(line, name, name_len) == 0) {
+            const char *v = line + name_len + 1;
+            const char *v_end = line + line_len;
+            while (v < v_end && (*v == ' ' || *v == '\t')) {
+                v++;
+            }
+            while (v_end > v && (v_end[-1] == '\r' || v_end[-1] == ' ')) {
+                v_end--;
+            }
+            snprintf(value, value_size, "%.*s", (int)(v_end - v), v);
+            return true;
+        }
+        if (end == NULL) {
+            break;
+        }
+        line = end + 1;
+    }
+    return false;
+}
+
+guint http_client_in_flight(const HttpClient *client) {
+    return client->in_flight;
+}
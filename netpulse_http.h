@@ -0,0 +1,49 @@
+#ifndef NETPULSE_HTTP_H
+#define NETPULSE_HTTP_H
+
+#include <glib.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct HttpClient HttpClient;
+
+typedef enum {
+    HTTP_PHASE_DNS,
+    HTTP_PHASE_CONNECT,
+    HTTP_PHASE_TLS,
+    HTTP_PHASE_TTFB,
+    HTTP_PHASE_COUNT,
+} HttpPhase;
+
+typedef struct {
+    double phase_ms[HTTP_PHASE_COUNT];
+    bool reused;
+} HttpTimings;
+
+typedef struct {
+    bool ok;
+    long status;
+    const char *body;
+    size_t body_len;
+    const char *headers;
+    const char *error;
+    const char *failure;
+    double total_ms;
+    HttpTimings timings;
+} HttpResponse;
+
+typedef void (*HttpDoneFunc)(const HttpResponse *response, gpointer user_data);
+typedef void (*HttpChunkFunc)(const char *data, size_t len, gpointer user_data);
+
+HttpClient *http_client_new(void);
+void http_client_free(HttpClient *client);
+void http_client_get(HttpClient *client, const char *url, long timeout_ms, HttpDoneFunc done, gpointer user_data);
+void http_client_post(HttpClient *client, const char *url, const char *content_type, const char *body, size_t body_len,
+                      long timeout_ms, HttpChunkFunc chunk, HttpDoneFunc done, gpointer user_data);
+void http_client_probe(HttpClient *client, const char *url, long timeout_ms, bool reuse, HttpDoneFunc done,
+                       gpointer user_data);
+const char *http_phase_name(HttpPhase phase);
+bool http_response_header(const HttpResponse *response, const char *name, char *value, size_t value_size);
+guint http_client_in_flight(const HttpClient *client);
+
+#endif
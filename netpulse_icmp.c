@@ -0,0 +1,565 @@
+#define _DEFAULT_SOURCE
+#include "netpulse_icmp.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <netdb.h>
+#include <netinet/icmp6.h>
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <netinet/ip_icmp.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#define ICMP_PAYLOAD_SIZE 16
+#define ICMP_MAX_PER_RUN 60000
+#define ICMP_DRAIN_EVERY 64
+#define ICMP_RCVBUF_PER_ECHO 2048
+#define ICMP_MAX_RCVBUF (32 * 1024 * 1024)
+
+/* One echo of a burst; echoes are laid out round by round, so the sequence number maps straight to a slot. */
+typedef struct {
+    struct timespec sent_at;
+    double rtt_ms;
+    bool sent;
+    bool received;
+} IcmpEcho;
+
+/* A chunk of probes in flight. Echoes are written by the sending thread and by the receiver thread, both
+   under the engine lock, and done is signalled once every echo sent so far has been answered. */
+struct IcmpBatch {
+    IcmpBatch *next;
+    const IcmpProbe *probes;
+    size_t count;
+    IcmpEcho *echoes;
+    size_t slots;
+    uint16_t base_seq;
+    size_t pending;
+    pthread_cond_t done;
+};
+
+static void *receiver_thread(void *data);
+
+static int open_icmp_socket(int family, int protocol, bool *raw) {
+    int fd = socket(family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, protocol);
+    if (fd >= 0) {
+        *raw = false;
+        return fd;
+    }
+
+    fd = socket(family, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, protocol);
+    if (fd >= 0) {
+        *raw = true;
+    }
+    return fd;
+}
+
+static void init_monotonic_cond(pthread_cond_t *cond) {
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+bool icmp_engine_open(IcmpEngine *engine) {
+    memset(engine, 0, sizeof(*engine));
+    pthread_mutex_init(&engine->lock, NULL);
+    init_monotonic_cond(&engine->seq_free);
+    engine->ident = (uint16_t)(getpid() & 0xffff);
+    engine->fd4 = open_icmp_socket(AF_INET, IPPROTO_ICMP, &engine->raw4);
+    engine->fd6 = open_icmp_socket(AF_INET6, IPPROTO_ICMPV6, &engine->raw6);
+    engine->wake_fd = -1;
+
+    if (engine->fd6 >= 0 && engine->raw6) {
+        struct icmp6_filter filter;
+        ICMP6_FILTER_SETBLOCKALL(&filter);
+        ICMP6_FILTER_SETPASS(ICMP6_ECHO_REPLY, &filter);
+        setsockopt(engine->fd6, IPPROTO_ICMPV6, ICMP6_FILTER, &filter, sizeof(filter));
+    }
+
+    if (engine->fd4 >= 0 || engine->fd6 >= 0) {
+        engine->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        engine->receiver_running =
+            engine->wake_fd >= 0 && pthread_create(&engine->receiver, NULL, receiver_thread, engine) == 0;
+    }
+    if (!engine->receiver_running) {
+        icmp_engine_close(engine);
+        return false;
+    }
+    return true;
+}
+
+void icmp_engine_close(IcmpEngine *engine) {
+    if (engine->receiver_running) {
+        uint64_t one = 1;
+        if (write(engine->wake_fd, &one, sizeof(one)) == (ssize_t)sizeof(one)) {
+            pthread_join(engine->receiver, NULL);
+        }
+        engine->receiver_running = false;
+    }
+    if (engine->wake_fd >= 0) {
+        close(engine->wake_fd);
+    }
+    if (engine->fd4 >= 0) {
+        close(engine->fd4);
+    }
+    if (engine->fd6 >= 0) {
+        close(engine->fd6);
+    }
+    engine->wake_fd = -1;
+    engine->fd4 = -1;
+    engine->fd6 = -1;
+    pthread_cond_destroy(&engine->seq_free);
+    pthread_mutex_destroy(&engine->lock);
+}
+
+const char *icmp_engine_describe(const IcmpEngine *engine) {
+    if (engine->fd4 < 0 && engine->fd6 < 0) {
+        return "unavailable";
+    }
+    if ((engine->fd4 >= 0 && engine->raw4) || (engine->fd6 >= 0 && engine->raw6)) {
+        return "raw socket";
+    }
+    return "unprivileged datagram socket";
+}
+
+static uint16_t icmp_checksum(const void *data, size_t len) {
+    const uint8_t *bytes = data;
+    uint32_t sum = 0;
+    while (len > 1) {
+        sum += (uint32_t)((bytes[0] << 8) | bytes[1]);
+        bytes += 2;
+        len -= 2;
+    }
+    if (len == 1) {
+        sum += (uint32_t)(bytes[0] << 8);
+    }
+    while (sum >> 16) {
+        sum = (sum & 0xffff) + (sum >> 16);
+    }
+    return htons((uint16_t)~sum);
+}
+
+static double elapsed_ms(const struct timespec *from, const struct timespec *to) {
+    return (double)(to->tv_sec - from->tv_sec) * 1000.0 + (double)(to->tv_nsec - from->tv_nsec) / 1e6;
+}
+
+static bool resolve_probe(const IcmpEngine *engine, IcmpProbe *probe) {
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_socktype = SOCK_RAW;
+    if (engine->fd4 < 0) {
+        hints.ai_family = AF_INET6;
+    } else if (engine->fd6 < 0) {
+        hints.ai_family = AF_INET;
+    } else {
+        hints.ai_family = AF_UNSPEC;
+    }
+
+    struct addrinfo *res = NULL;
+    if (getaddrinfo(probe->host, NULL, &hints, &res) != 0 || res == NULL) {
+        return false;
+    }
+
+    memcpy(&probe->addr, res->ai_addr, res->ai_addrlen);
+    probe->addr_len = res->ai_addrlen;
+    freeaddrinfo(res);
+    return true;
+}
+
+static bool send_echo(IcmpEngine *engine, const IcmpProbe *probe, uint16_t seq) {
+    uint8_t packet[sizeof(struct icmphdr) + ICMP_PAYLOAD_SIZE];
+    memset(packet, 0, sizeof(packet));
+    memcpy(packet + sizeof(struct icmphdr), "netpulse-echo...", ICMP_PAYLOAD_SIZE);
+
+    int fd;
+    if (probe->addr.ss_family == AF_INET6) {
+        struct icmp6_hdr *hdr = (struct icmp6_hdr *)packet;
+        hdr->icmp6_type = ICMP6_ECHO_REQUEST;
+        hdr->icmp6_id = htons(engine->ident);
+        hdr->icmp6_seq = htons(seq);
+        fd = engine->fd6;
+    } else {
+        struct icmphdr *hdr = (struct icmphdr *)packet;
+        hdr->type = ICMP_ECHO;
+        hdr->un.echo.id = htons(engine->ident);
+        hdr->un.echo.sequence = htons(seq);
+        hdr->checksum = icmp_checksum(packet, sizeof(packet));
+        fd = engine->fd4;
+    }
+    if (fd < 0) {
+        return false;
+    }
+
+    ssize_t n = sendto(fd, packet, sizeof(packet), 0, (struct sockaddr *)&probe->addr, probe->addr_len);
+    return n == (ssize_t)sizeof(packet);
+}
+
+static bool same_address(const struct sockaddr_storage *a, const struct sockaddr_storage *b) {
+    if (a->ss_family != b->ss_family) {
+        return false;
+    }
+    if (a->ss_family == AF_INET6) {
+        return memcmp(&((const struct sockaddr_in6 *)a)->sin6_addr, &((const struct sockaddr_in6 *)b)->sin6_addr,
+                      sizeof(struct in6_addr)) == 0;
+    }
+    return ((const struct sockaddr_in *)a)->sin_addr.s_addr == ((const struct sockaddr_in *)b)->sin_addr.s_addr;
+}
+
+/* Marks the echo's owner as answered; a reply for a batch that already finished, or from the wrong address,
+   is dropped. */
+static void route_reply(IcmpEngine *engine, uint16_t seq, const struct sockaddr_storage *from,
+                        const struct timespec *now) {
+    pthread_mutex_lock(&engine->lock);
+    for (IcmpBatch *batch = engine->batches; batch != NULL; batch = batch->next) {
+        size_t idx = (uint16_t)(seq - batch->base_seq);
+        if (idx >= batch->slots) {
+            continue;
+        }
+        IcmpEcho *echo = &batch->echoes[idx];
+        if (echo->sent && !echo->received && same_address(&batch->probes[idx % batch->count].addr, from)) {
+            echo->received = true;
+            echo->rtt_ms = elapsed_ms(&echo->sent_at, now);
+            if (--batch->pending == 0) {
+                pthread_cond_signal(&batch->done);
+            }
+        }
+        break;
+    }
+    pthread_mutex_unlock(&engine->lock);
+}
+
+static void drain_replies(IcmpEngine *engine, int fd, bool v6) {
+    uint8_t buf[1500];
+    bool raw = v6 ? engine->raw6 : engine->raw4;
+
+    for (;;) {
+        struct sockaddr_storage from;
+        socklen_t from_len = sizeof(from);
+        ssize_t n = recvfrom(fd, buf, sizeof(buf), 0, (struct sockaddr *)&from, &from_len);
+        if (n < 0) {
+            break;
+        }
+
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        const uint8_t *icmp = buf;
+        size_t icmp_len = (size_t)n;
+        uint16_t id;
+        uint16_t seq;
+        if (v6) {
+            if (icmp_len < sizeof(struct icmp6_hdr)) {
+                continue;
+            }
+            const struct icmp6_hdr *hdr = (const struct icmp6_hdr *)icmp;
+            if (hdr->icmp6_type != ICMP6_ECHO_REPLY) {
+                continue;
+            }
+            id = ntohs(hdr->icmp6_id);
+            seq = ntohs(hdr->icmp6_seq);
+        } else {
+            if (raw) {
+                if (icmp_len < sizeof(struct iphdr)) {
+                    continue;
+                }
+                size_t ihl = (size_t)((const struct iphdr *)buf)->ihl * 4;
+                if (icmp_len < ihl + sizeof(struct icmphdr)) {
+                    continue;
+                }
+                icmp += ihl;
+                icmp_len -= ihl;
+            } else if (icmp_len < sizeof(struct icmphdr)) {
+                continue;
+            }
+            const struct icmphdr *hdr = (const struct icmphdr *)icmp;
+            if (hdr->type != ICMP_ECHOREPLY) {
+                continue;
+            }
+            id = ntohs(hdr->un.echo.id);
+            seq = ntohs(hdr->un.echo.sequence);
+        }
+
+        /* Datagram sockets get their id rewritten by the kernel and only see their own replies. */
+        if (raw && id != engine->ident) {
+            continue;
+        }
+        route_reply(engine, seq, &from, &now);
+    }
+}
+
+static void drain_sockets(IcmpEngine *engine) {
+    if (engine->fd4 >= 0) {
+        drain_replies(engine, engine->fd4, false);
+    }
+    if (engine->fd6 >= 0) {
+        drain_replies(engine, engine->fd6, true);
+    }
+}
+
+static void *receiver_thread(void *data) {
+    IcmpEngine *engine = data;
+    for (;;) {
+        struct pollfd fds[3];
+        nfds_t nfds = 0;
+        fds[nfds].fd = engine->wake_fd;
+        fds[nfds].events = POLLIN;
+        nfds++;
+        if (engine->fd4 >= 0) {
+            fds[nfds].fd = engine->fd4;
+            fds[nfds].events = POLLIN;
+            nfds++;
+        }
+        if (engine->fd6 >= 0) {
+            fds[nfds].fd = engine->fd6;
+            fds[nfds].events = POLLIN;
+            nfds++;
+        }
+
+        if (poll(fds, nfds, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return NULL;
+        }
+        if (fds[0].revents & POLLIN) {
+            return NULL;
+        }
+        for (nfds_t i = 1; i < nfds; ++i) {
+            if (fds[i].revents & POLLIN) {
+                drain_replies(engine, fds[i].fd, fds[i].fd == engine->fd6);
+            }
+        }
+    }
+}
+
+static bool ranges_overlap(uint16_t a, size_t a_len, uint16_t b, size_t b_len) {
+    return (uint16_t)(b - a) < a_len || (uint16_t)(a - b) < b_len;
+}
+
+/* Takes the next free sequence range. Ranges of running batches are never reused, so when a large chunk
+   would wrap onto one it waits for that batch to finish. */
+static size_t register_batch(IcmpEngine *engine, IcmpBatch *batch) {
+    pthread_mutex_lock(&engine->lock);
+    for (;;) {
+        bool clash = false;
+        for (const IcmpBatch *other = engine->batches; other != NULL && !clash; other = other->next) {
+            clash = ranges_overlap(engine->next_seq, batch->slots, other->base_seq, other->slots);
+        }
+        if (!clash) {
+            break;
+        }
+        pthread_cond_wait(&engine->seq_free, &engine->lock);
+    }
+    batch->base_seq = engine->next_seq;
+    engine->next_seq = (uint16_t)(engine->next_seq + batch->slots);
+    batch->next = engine->batches;
+    engine->batches = batch;
+    size_t outstanding = 0;
+    for (const IcmpBatch *other = engine->batches; other != NULL; other = other->next) {
+        outstanding += other->slots;
+    }
+    pthread_mutex_unlock(&engine->lock);
+    return outstanding;
+}
+
+/* The default receive buffer holds only about 128 echo replies (and on loopback a raw socket also queues
+   our own requests), so a larger round would lose replies before anyone reads them. SO_RCVBUF stops at
+   net.core.rmem_max; SO_RCVBUFFORCE goes past it when the process has CAP_NET_ADMIN. Buffers only grow. */
+static void grow_receive_buffer(int fd, size_t echoes) {
+    if (fd < 0) {
+        return;
+    }
+    int wanted = echoes > ICMP_MAX_RCVBUF / ICMP_RCVBUF_PER_ECHO ? ICMP_MAX_RCVBUF
+                                                                  : (int)echoes * ICMP_RCVBUF_PER_ECHO;
+    int current = 0;
+    socklen_t len = sizeof(current);
+    if (getsockopt(fd, SOL_SOCKET, SO_RCVBUF, &current, &len) == 0 && current >= wanted) {
+        return;
+    }
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &wanted, sizeof(wanted));
+    len = sizeof(current);
+    if (getsockopt(fd, SOL_SOCKET, SO_RCVBUF, &current, &len) != 0 || current < wanted) {
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &wanted, sizeof(wanted));
+    }
+}
+
+static void unregister_batch(IcmpEngine *engine, IcmpBatch *batch) {
+    pthread_mutex_lock(&engine->lock);
+    for (IcmpBatch **link = &engine->batches; *link != NULL; link = &(*link)->next) {
+        if (*link == batch) {
+            *link = batch->next;
+            break;
+        }
+    }
+    pthread_cond_broadcast(&engine->seq_free);
+    pthread_mutex_unlock(&engine->lock);
+}
+
+/* The echo is marked sent before the packet leaves, since the receiver thread may see the reply before
+   sendto returns. */
+static void send_slot(IcmpEngine *engine, IcmpBatch *batch, IcmpProbe *probe, size_t slot) {
+    IcmpEcho *echo = &batch->echoes[slot];
+    pthread_mutex_lock(&engine->lock);
+    echo->sent = true;
+    batch->pending++;
+    clock_gettime(CLOCK_MONOTONIC, &echo->sent_at);
+    pthread_mutex_unlock(&engine->lock);
+
+    if (send_echo(engine, probe, (uint16_t)(batch->base_seq + slot))) {
+        probe->sent_count++;
+        return;
+    }
+    pthread_mutex_lock(&engine->lock);
+    echo->sent = false;
+    batch->pending--;
+    pthread_mutex_unlock(&engine->lock);
+    probe->send_errors++;
+}
+
+/* Sleeps until the deadline, or until every echo sent so far is answered when stop_when_done is set. */
+static void wait_replies(IcmpEngine *engine, IcmpBatch *batch, const struct timespec *deadline,
+                         bool stop_when_done) {
+    pthread_mutex_lock(&engine->lock);
+    while (!stop_when_done || batch->pending > 0) {
+        if (pthread_cond_timedwait(&batch->done, &engine->lock, deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+    pthread_mutex_unlock(&engine->lock);
+}
+
+static void add_ms(struct timespec *ts, double ms) {
+    int64_t ns = (int64_t)ts->tv_nsec + (int64_t)(ms * 1e6);
+    ts->tv_sec += (time_t)(ns / 1000000000);
+    ts->tv_nsec = (long)(ns % 1000000000);
+}
+
+/* Every round sends one echo to each target back to back over the shared sockets while the receiver thread
+   collects replies, so a burst costs its spacing rather than a timeout per echo. */
+static void run_chunk(IcmpEngine *engine, IcmpProbe *probes, size_t count, int burst, int spacing_ms,
+                      int timeout_ms) {
+    IcmpBatch batch;
+    memset(&batch, 0, sizeof(batch));
+    batch.probes = probes;
+    batch.count = count;
+    batch.slots = count * (size_t)burst;
+    batch.echoes = calloc(batch.slots, sizeof(IcmpEcho));
+    bool *resolved = calloc(count, sizeof(bool));
+    for (size_t i = 0; i < count; ++i) {
+        IcmpProbe *probe = &probes[i];
+        probe->success = false;
+        probe->has_latency = false;
+        probe->has_jitter = false;
+        probe->sent_count = 0;
+        probe->send_errors = 0;
+        probe->received = 0;
+        resolved[i] = batch.echoes != NULL && probe->host != NULL && resolve_probe(engine, probe);
+    }
+    if (batch.echoes == NULL || resolved == NULL) {
+        free(resolved);
+        free(batch.echoes);
+        return;
+    }
+
+    init_monotonic_cond(&batch.done);
+    size_t outstanding = register_batch(engine, &batch);
+    grow_receive_buffer(engine->fd4, outstanding);
+    grow_receive_buffer(engine->fd6, outstanding);
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    struct timespec deadline = start;
+    for (int round = 0; round < burst; ++round) {
+        if (round > 0) {
+            struct timespec next_round = start;
+            add_ms(&next_round, (double)round * spacing_ms);
+            wait_replies(engine, &batch, &next_round, false);
+        }
+        size_t sent = 0;
+        for (size_t i = 0; i < count; ++i) {
+            if (!resolved[i]) {
+                continue;
+            }
+            send_slot(engine, &batch, &probes[i], (size_t)round * count + i);
+            /* Replies are routed by sequence under the lock, so the sender can help the receiver thread
+               empty the sockets while a large round is still going out. */
+            if (++sent % ICMP_DRAIN_EVERY == 0) {
+                drain_sockets(engine);
+            }
+        }
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+    }
+    add_ms(&deadline, timeout_ms);
+    wait_replies(engine, &batch, &deadline, true);
+    unregister_batch(engine, &batch);
+    pthread_cond_destroy(&batch.done);
+
+    double *rtt_ms = malloc((size_t)burst * sizeof(double));
+    for (size_t i = 0; i < count && rtt_ms != NULL; ++i) {
+        bool first = true;
+        for (int round = 0; round < burst; ++round) {
+            const IcmpEcho *echo = &batch.echoes[(size_t)round * count + i];
+            /* A reply later than the timeout counts as lost, as it would for a single echo. */
+            rtt_ms[round] = echo->received && echo->rtt_ms <= timeout_ms ? echo->rtt_ms : -1.0;
+            if (echo->sent && first) {
+                probes[i].sent_at = echo->sent_at;
+                first = false;
+            }
+        }
+        icmp_probe_summarize(&probes[i], rtt_ms, (size_t)burst, probes[i].sent_count);
+    }
+    free(rtt_ms);
+    free(resolved);
+    free(batch.echoes);
+}
+
+void icmp_engine_run(IcmpEngine *engine, IcmpProbe *probes, size_t count, int burst, int spacing_ms, int timeout_ms) {
+    if (burst < 1) {
+        burst = 1;
+    }
+    size_t per_run = ICMP_MAX_PER_RUN / (size_t)burst;
+    size_t offset = 0;
+    while (offset < count) {
+        size_t chunk = count - offset;
+        if (chunk > per_run) {
+            chunk = per_run;
+        }
+        run_chunk(engine, probes + offset, chunk, burst, spacing_ms, timeout_ms);
+        offset += chunk;
+    }
+}
+
+/* rtt_ms holds one entry per echo in send order, negative for a lost echo. Jitter follows RFC 3550:
+   J += (|D| - J) / 16, where D is the difference between consecutive round trips. */
+void icmp_probe_summarize(IcmpProbe *probe, const double *rtt_ms, size_t count, int sent) {
+    double sum = 0.0;
+    double previous = 0.0;
+    probe->sent_count = sent;
+    probe->received = 0;
+    probe->jitter_ms = 0.0;
+    for (size_t i = 0; i < count; ++i) {
+        if (rtt_ms[i] < 0.0) {
+            continue;
+        }
+        if (probe->received == 0) {
+            probe->min_ms = rtt_ms[i];
+            probe->max_ms = rtt_ms[i];
+        } else {
+            probe->min_ms = fmin(probe->min_ms, rtt_ms[i]);
+            probe->max_ms = fmax(probe->max_ms, rtt_ms[i]);
+            probe->jitter_ms += (fabs(rtt_ms[i] - previous) - probe->jitter_ms) / 16.0;
+        }
+        previous = rtt_ms[i];
+        sum += rtt_ms[i];
+        probe->received++;
+    }
+    probe->success = probe->received > 0;
+    probe->has_latency = probe->success;
+    probe->latency_ms = probe->success ? sum / probe->received : 0.0;
+    probe->has_jitter = probe->received > 1;
+}
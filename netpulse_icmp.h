@@ -0,0 +1,56 @@
+#ifndef NETPULSE_ICMP_H
+#define NETPULSE_ICMP_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/socket.h>
+#include <time.h>
+
+typedef struct IcmpBatch IcmpBatch;
+
+/* One receiver thread owns the reads on both sockets and hands each reply to the running batch whose
+   sequence range holds it, so any number of worker threads can run batches over the same sockets. */
+typedef struct {
+    int fd4;
+    int fd6;
+    bool raw4;
+    bool raw6;
+    uint16_t ident;
+    uint16_t next_seq;
+    int wake_fd;
+    pthread_t receiver;
+    bool receiver_running;
+    pthread_mutex_t lock;
+    pthread_cond_t seq_free;
+    IcmpBatch *batches;
+} IcmpEngine;
+
+/* With a burst of more than one echo, latency_ms is the mean of the replies and jitter_ms is the
+   RFC 3550 interarrival jitter over consecutive replies. */
+typedef struct {
+    const char *host;
+    bool success;
+    double latency_ms;
+    bool has_latency;
+    int sent_count;
+    int send_errors;
+    int received;
+    double min_ms;
+    double max_ms;
+    double jitter_ms;
+    bool has_jitter;
+
+    struct sockaddr_storage addr;
+    socklen_t addr_len;
+    struct timespec sent_at;
+} IcmpProbe;
+
+bool icmp_engine_open(IcmpEngine *engine);
+void icmp_engine_close(IcmpEngine *engine);
+const char *icmp_engine_describe(const IcmpEngine *engine);
+void icmp_engine_run(IcmpEngine *engine, IcmpProbe *probes, size_t count, int burst, int spacing_ms, int timeout_ms);
+void icmp_probe_summarize(IcmpProbe *probe, const double *rtt_ms, size_t count, int sent);
+
+#endif
@@ -0,0 +1,418 @@
+#include "netpulse_json.h"
+
+#include <string.h>
+
+/* A small single-pass reader for probe results. It walks the receive buffer once with an explicit end
+   pointer, copies only the fields it keeps into the caller's struct, and never allocates. */
+
+typedef enum {
+    JSON_OK,
+    JSON_INCOMPLETE,
+    JSON_INVALID,
+} JsonStatus;
+
+typedef enum {
+    JSON_TRUE,
+    JSON_FALSE,
+    JSON_NULL,
+} JsonLiteral;
+
+typedef struct {
+    const char *p;
+    const char *end;
+} JsonCursor;
+
+static void skip_space(JsonCursor *c) {
+    while (c->p < c->end && (*c->p == ' ' || *c->p == '\t' || *c->p == '\r' || *c->p == '\n')) {
+        c->p++;
+    }
+}
+
+static int hex_value(char ch) {
+    if (ch >= '0' && ch <= '9') {
+        return ch - '0';
+    }
+    if (ch >= 'a' && ch <= 'f') {
+        return ch - 'a' + 10;
+    }
+    if (ch >= 'A' && ch <= 'F') {
+        return ch - 'A' + 10;
+    }
+    return -1;
+}
+
+static void put_byte(char *out, size_t out_size, size_t *n, unsigned int byte) {
+    if (out != NULL && *n + 1 < out_size) {
+        out[(*n)++] = (char)byte;
+    }
+}
+
+/* Code points outside the basic plane arrive as surrogate pairs and are replaced with '?'. */
+static void put_code_point(char *out, size_t out_size, size_t *n, unsigned int code) {
+    if (code < 0x80) {
+        put_byte(out, out_size, n, code);
+    } else if (code < 0x800) {
+        put_byte(out, out_size, n, 0xC0 | (code >> 6));
+        put_byte(out, out_size, n, 0x80 | (code & 0x3F));
+    } else if (code >= 0xD800 && code <= 0xDFFF) {
+        put_byte(out, out_size, n, '?');
+    } else {
+        put_byte(out, out_size, n, 0xE0 | (code >> 12));
+        put_byte(out, out_size, n, 0x80 | ((code >> 6) & 0x3F));
+        put_byte(out, out_size, n, 0x80 | (code & 0x3F));
+    }
+}
+
+/* Reads a string token, decoding escapes into out (truncated to out_size); out may be NULL to skip it. */
+static JsonStatus read_string(JsonCursor *c, char *out, size_t out_size) {
+    size_t n = 0;
+    c->p++;
+    while (c->p < c->end) {
+        char ch = *c->p++;
+        if (ch == '"') {
+            if (out != NULL) {
+                out[n] = '\0';
+            }
+            return JSON_OK;
+        }
+        if (ch != '\\') {
+            put_byte(out, out_size, &n, (unsigned char)ch);
+            continue;
+        }
+        if (c->p >= c->end) {
+            return JSON_INCOMPLETE;
+        }
+        char esc = *c->p++;
+        switch (esc) {
+        case 'n':
+            put_byte(out, out_size, &n, '\n');
+            break;
+        case 't':
+            put_byte(out, out_size, &n, '\t');
+            break;
+        case 'r':
+            put_byte(out, out_size, &n, '\r');
+            break;
+        case 'b':
+            put_byte(out, out_size, &n, '\b');
+            break;
+        case 'f':
+            put_byte(out, out_size, &n, '\f');
+            break;
+        case 'u': {
+            if (c->end - c->p < 4) {
+                return JSON_INCOMPLETE;
+            }
+            unsigned int code = 0;
+            for (int i = 0; i < 4; ++i) {
+                int digit = hex_value(c->p[i]);
+                if (digit < 0) {
+                    return JSON_INVALID;
+                }
+                code = code << 4 | (unsigned int)digit;
+            }
+            c->p += 4;
+            put_code_point(out, out_size, &n, code);
+            break;
+        }
+        default:
+            put_byte(out, out_size, &n, (unsigned char)esc);
+            break;
+        }
+    }
+    return JSON_INCOMPLETE;
+}
+
+/* Parsed by hand rather than with strtod(), which follows LC_NUMERIC and would stop at the '.' under
+   locales that use a decimal comma. */
+static JsonStatus read_number(JsonCursor *c, double *value) {
+    const char *p = c->p;
+    bool negative = false;
+    if (p < c->end && *p == '-') {
+        negative = true;
+        p++;
+    }
+    if (p < c->end && (*p < '0' || *p > '9')) {
+        return JSON_INVALID;
+    }
+
+    double v = 0.0;
+    while (p < c->end && *p >= '0' && *p <= '9') {
+        v = v * 10.0 + (*p++ - '0');
+    }
+    if (p < c->end && *p == '.') {
+        double scale = 0.1;
+        for (p++; p < c->end && *p >= '0' && *p <= '9'; p++) {
+            v += (*p - '0') * scale;
+            scale *= 0.1;
+        }
+    }
+    if (p < c->end && (*p == 'e' || *p == 'E')) {
+        p++;
+        bool negative_exp = false;
+        if (p < c->end && (*p == '+' || *p == '-')) {
+            negative_exp = *p == '-';
+            p++;
+        }
+        int exponent = 0;
+        while (p < c->end && *p >= '0' && *p <= '9') {
+            exponent = exponent < 400 ? exponent * 10 + (*p - '0') : exponent;
+            p++;
+        }
+        for (; exponent > 0; --exponent) {
+            v = negative_exp ? v / 10.0 : v * 10.0;
+        }
+    }
+    /* A number that runs to the end of the buffer may continue in the next chunk. */
+    if (p >= c->end) {
+        return JSON_INCOMPLETE;
+    }
+    *value = negative ? -v : v;
+    c->p = p;
+    return JSON_OK;
+}
+
+static JsonStatus read_literal(JsonCursor *c, JsonLiteral *literal) {
+    static const char *const words[] = {"true", "false", "null"};
+    for (size_t i = 0; i < sizeof(words) / sizeof(words[0]); ++i) {
+        size_t len = strlen(words[i]);
+        size_t available = (size_t)(c->end - c->p);
+        if (strncmp(c->p, words[i], available < len ? available : len) != 0) {
+            continue;
+        }
+        if (available < len) {
+            return JSON_INCOMPLETE;
+        }
+        c->p += len;
+        *literal = (JsonLiteral)i;
+        return JSON_OK;
+    }
+    return JSON_INVALID;
+}
+
+/* Skips any value, including nested objects and arrays, in one forward pass. */
+static JsonStatus skip_value(JsonCursor *c) {
+    if (c->p >= c->end) {
+        return JSON_INCOMPLETE;
+    }
+    char ch = *c->p;
+    if (ch == '"') {
+        return read_string(c, NULL, 0);
+    }
+    if (ch == '-' || (ch >= '0' && ch <= '9')) {
+        double ignored;
+        return read_number(c, &ignored);
+    }
+    if (ch != '{' && ch != '[') {
+        JsonLiteral ignored;
+        return read_literal(c, &ignored);
+    }
+
+    int depth = 0;
+    while (c->p < c->end) {
+        ch = *c->p;
+        if (ch == '"') {
+            JsonStatus status = read_string(c, NULL, 0);
+            if (status != JSON_OK) {
+                return status;
+            }
+            continue;
+        }
+        c->p++;
+        if (ch == '{' || ch == '[') {
+            depth++;
+        } else if ((ch == '}' || ch == ']') && --depth == 0) {
+            return JSON_OK;
+        }
+    }
+    return JSON_INCOMPLETE;
+}
+
+static JsonStatus read_bool(JsonCursor *c, bool *value) {
+    if (c->p < c->end && (*c->p == 't' || *c->p == 'f' || *c->p == 'n')) {
+        JsonLiteral literal;
+        JsonStatus status = read_literal(c, &literal);
+        if (status == JSON_OK && literal != JSON_NULL) {
+            *value = literal == JSON_TRUE;
+        }
+        return status;
+    }
+    return skip_value(c);
+}
+
+static JsonStatus read_double(JsonCursor *c, double *value, bool *present) {
+    if (c->p < c->end && (*c->p == '-' || (*c->p >= '0' && *c->p <= '9'))) {
+        JsonStatus status = read_number(c, value);
+        if (status == JSON_OK && present != NULL) {
+            *present = true;
+        }
+        return status;
+    }
+    return skip_value(c);
+}
+
+static JsonStatus read_int(JsonCursor *c, int *value) {
+    double parsed = 0.0;
+    bool present = false;
+    JsonStatus status = read_double(c, &parsed, &present);
+    if (present) {
+        *value = (int)parsed;
+    }
+    return status;
+}
+
+static JsonStatus read_string_field(JsonCursor *c, char *out, size_t out_size, bool *present) {
+    if (c->p < c->end && *c->p == '"') {
+        JsonStatus status = read_string(c, out, out_size);
+        if (status == JSON_OK && present != NULL) {
+            *present = true;
+        }
+        return status;
+    }
+    return skip_value(c);
+}
+
+static JsonStatus read_field(JsonCursor *c, const char *key, ProbeResult *result) {
+    if (strcmp(key, "ok") == 0 || strcmp(key, "success") == 0) {
+        return read_bool(c, &result->ok);
+    }
+    if (strcmp(key, "latency_ms") == 0) {
+        return read_double(c, &result->latency_ms, &result->has_latency);
+    }
+    if (strcmp(key, "loss_pct") == 0 || strcmp(key, "loss") == 0) {
+        return read_double(c, &result->loss_pct, &result->has_loss);
+    }
+    if (strcmp(key, "jitter_ms") == 0) {
+        return read_double(c, &result->jitter_ms, &result->has_jitter);
+    }
+    if (strcmp(key, "samples") == 0) {
+        return read_int(c, &result->samples);
+    }
+    if (strcmp(key, "error_code") == 0) {
+        return read_int(c, &result->error_code);
+    }
+    if (strcmp(key, "error") == 0) {
+        return read_string_field(c, result->error, sizeof(result->error), NULL);
+    }
+    if (strcmp(key, "target") == 0) {
+        return read_string_field(c, result->target, sizeof(result->target), &result->has_target);
+    }
+    return skip_value(c);
+}
+
+static JsonStatus parse_object(JsonCursor *c, ProbeResult *result) {
+    memset(result, 0, sizeof(*result));
+    result->ok = true;
+    c->p++;
+    skip_space(c);
+    if (c->p < c->end && *c->p == '}') {
+        c->p++;
+        return JSON_OK;
+    }
+
+    while (c->p < c->end) {
+        if (*c->p != '"') {
+            return JSON_INVALID;
+        }
+        char key[32];
+        JsonStatus status = read_string(c, key, sizeof(key));
+        if (status != JSON_OK) {
+            return status;
+        }
+        skip_space(c);
+        if (c->p >= c->end) {
+            return JSON_INCOMPLETE;
+        }
+        if (*c->p++ != ':') {
+            return JSON_INVALID;
+        }
+        skip_space(c);
+        status = read_field(c, key, result);
+        if (status != JSON_OK) {
+            return status;
+        }
+        skip_space(c);
+        if (c->p >= c->end) {
+            return JSON_INCOMPLETE;
+        }
+        char ch = *c->p++;
+        if (ch == '}') {
+            return JSON_OK;
+        }
+        if (ch != ',') {
+            return JSON_INVALID;
+        }
+        skip_space(c);
+    }
+    return JSON_INCOMPLETE;
+}
+
+/* Parses one object starting at json. Returns the position after it, or NULL when the object is
+   incomplete or malformed. Fields that are absent keep their defaults: ok is true, counts are zero. */
+const char *probe_result_parse(const char *json, const char *end, ProbeResult *result) {
+    JsonCursor c = {json, end};
+    skip_space(&c);
+    if (c.p >= c.end || *c.p != '{') {
+        return NULL;
+    }
+    return parse_object(&c, result) == JSON_OK ? c.p : NULL;
+}
+
+/* Walks a single object, a JSON array of objects or NDJSON lines, calling func for each complete object.
+   Returns how many bytes were consumed, so a streaming caller keeps only the unfinished tail. A malformed
+   object is skipped as a whole value, or up to the next line when its line ends first, so one bad element
+   of a single-line array does not hold back the results after it. */
+size_t probe_results_scan(const char *data, size_t len, ProbeResultFunc func, void *user_data) {
+    JsonCursor c = {data, data + len};
+    const char *consumed = data;
+    while (c.p < c.end) {
+        char ch = *c.p;
+        if (ch != '{') {
+            c.p++;
+            consumed = c.p;
+            continue;
+        }
+
+        ProbeResult result;
+        const char *start = c.p;
+        JsonStatus status = parse_object(&c, &result);
+        if (status == JSON_INCOMPLETE) {
+            break;
+        }
+        if (status == JSON_OK) {
+            func(&result, user_data);
+        } else {
+            const char *bad = c.p;
+            c.p = start;
+            JsonStatus skipped = skip_value(&c);
+            const char *newline = memchr(bad, '\n', (size_t)(c.end - bad));
+            if (newline != NULL && (skipped != JSON_OK || newline < c.p)) {
+                c.p = newline + 1;
+            } else if (skipped == JSON_INCOMPLETE) {
+                c.p = start;
+                break;
+            } else if (skipped != JSON_OK) {
+                c.p = start + 1;
+            }
+        }
+        consumed = c.p;
+    }
+    return (size_t)(consumed - data);
+}
+
+/* Appends value as a quoted JSON string, escaping quotes, backslashes and control characters. */
+void append_json_string(GString *out, const char *value) {
+    g_string_append_c(out, '"');
+    for (const char *p = value; *p != '\0'; ++p) {
+        unsigned char c = (unsigned char)*p;
+        if (c == '"' || c == '\\') {
+            g_string_append_c(out, '\\');
+            g_string_append_c(out, (char)c);
+        } else if (c < 0x20) {
+            g_string_append_printf(out, "\\u%04x", c);
+        } else {
+            g_string_append_c(out, (char)c);
+        }
+    }
+    g_string_append_c(out, '"');
+}
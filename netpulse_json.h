@@ -0,0 +1,30 @@
+#ifndef NETPULSE_JSON_H
+#define NETPULSE_JSON_H
+
+#include <glib.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct {
+    char target[256];
+    bool has_target;
+    bool ok;
+    double latency_ms;
+    bool has_latency;
+    double loss_pct;
+    bool has_loss;
+    double jitter_ms;
+    bool has_jitter;
+    int samples;
+    int error_code;
+    char error[128];
+} ProbeResult;
+
+typedef void (*ProbeResultFunc)(const ProbeResult *result, void *user_data);
+
+const char *probe_result_parse(const char *json, const char *end, ProbeResult *result);
+size_t probe_results_scan(const char *data, size_t len, ProbeResultFunc func, void *user_data);
+
+void append_json_string(GString *out, const char *value);
+
+#endif
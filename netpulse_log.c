@@ -0,0 +1,172 @@
+#define _POSIX_C_SOURCE 200809L
+#include "netpulse_log.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define LOG_WRITER_MAX_QUEUED 4096
+
+struct LogWriter {
+    char *path;
+    size_t max_bytes;
+    int keep_files;
+    FILE *file;
+    size_t file_bytes;
+    GAsyncQueue *queue;
+    GThread *thread;
+    guint dropped;
+};
+
+/* Pushed by log_writer_close() to tell the writer thread to drain and exit. */
+static char stop_marker;
+
+void log_ring_init(LogRing *ring, guint capacity) {
+    ring->lines = g_new0(char *, capacity);
+    ring->capacity = capacity;
+    ring->start = 0;
+    ring->count = 0;
+    ring->unflushed = 0;
+}
+
+void log_ring_free(LogRing *ring) {
+    for (guint i = 0; i < ring->capacity; ++i) {
+        g_free(ring->lines[i]);
+    }
+    g_free(ring->lines);
+    ring->lines = NULL;
+    ring->capacity = 0;
+    ring->count = 0;
+    ring->unflushed = 0;
+}
+
+void log_ring_push(LogRing *ring, const char *line) {
+    guint slot = (ring->start + ring->count) % ring->capacity;
+    if (ring->count == ring->capacity) {
+        ring->start = (ring->start + 1) % ring->capacity;
+    } else {
+        ring->count++;
+    }
+    g_free(ring->lines[slot]);
+    ring->lines[slot] = g_strdup(line);
+    if (ring->unflushed < ring->capacity) {
+        ring->unflushed++;
+    }
+}
+
+guint log_ring_take_unflushed(LogRing *ring, GString *out) {
+    guint taken = ring->unflushed;
+    for (guint i = ring->count - taken; i < ring->count; ++i) {
+        g_string_append(out, ring->lines[(ring->start + i) % ring->capacity]);
+    }
+    ring->unflushed = 0;
+    return taken;
+}
+
+static void open_log_file(LogWriter *writer) {
+    writer->file = fopen(writer->path, "a");
+    writer->file_bytes = 0;
+    if (writer->file != NULL) {
+        struct stat st;
+        if (fstat(fileno(writer->file), &st) == 0) {
+            writer->file_bytes = (size_t)st.st_size;
+        }
+    }
+}
+
+static void rotate_log_file(LogWriter *writer) {
+    fclose(writer->file);
+    writer->file = NULL;
+
+    for (int i = writer->keep_files - 1; i >= 1; --i) {
+        char *from = i == 1 ? g_strdup(writer->path) : g_strdup_printf("%s.%d", writer->path, i - 1);
+        char *to = g_strdup_printf("%s.%d", writer->path, i);
+        rename(from, to);
+        g_free(from);
+        g_free(to);
+    }
+    if (writer->keep_files <= 1) {
+        remove(writer->path);
+    }
+    open_log_file(writer);
+}
+
+static void write_line(LogWriter *writer, const char *line) {
+    if (writer->file == NULL) {
+        return;
+    }
+    size_t len = strlen(line);
+    if (writer->file_bytes > 0 && writer->file_bytes + len > writer->max_bytes) {
+        rotate_log_file(writer);
+        if (writer->file == NULL) {
+            return;
+        }
+    }
+    fputs(line, writer->file);
+    writer->file_bytes += len;
+}
+
+static gpointer log_writer_thread(gpointer data) {
+    LogWriter *writer = data;
+    for (;;) {
+        char *line = g_async_queue_pop(writer->queue);
+        do {
+            if (line == &stop_marker) {
+                if (writer->file != NULL) {
+                    fclose(writer->file);
+                    writer->file = NULL;
+                }
+                return NULL;
+            }
+
+            guint dropped = g_atomic_int_and(&writer->dropped, 0);
+            if (dropped > 0) {
+                char note[96];
+                snprintf(note, sizeof(note), "[log] %u lines dropped; writer fell behind\n", dropped);
+                write_line(writer, note);
+            }
+            write_line(writer, line);
+            g_free(line);
+        } while ((line = g_async_queue_try_pop(writer->queue)) != NULL);
+
+        if (writer->file != NULL) {
+            fflush(writer->file);
+        }
+    }
+}
+
+LogWriter *log_writer_open(const char *path, size_t max_bytes, int keep_files) {
+    LogWriter *writer = g_new0(LogWriter, 1);
+    writer->path = g_strdup(path);
+    writer->max_bytes = max_bytes;
+    writer->keep_files = keep_files;
+    open_log_file(writer);
+    if (writer->file == NULL) {
+        g_free(writer->path);
+        g_free(writer);
+        return NULL;
+    }
+
+    writer->queue = g_async_queue_new();
+    writer->thread = g_thread_new("netpulse-log", log_writer_thread, writer);
+    return writer;
+}
+
+void log_writer_append(LogWriter *writer, const char *line) {
+    if (g_async_queue_length(writer->queue) >= LOG_WRITER_MAX_QUEUED) {
+        g_atomic_int_inc(&writer->dropped);
+        return;
+    }
+    g_async_queue_push(writer->queue, g_strdup(line));
+}
+
+void log_writer_close(LogWriter *writer) {
+    if (writer == NULL) {
+        return;
+    }
+    g_async_queue_push(writer->queue, &stop_marker);
+    g_thread_join(writer->thread);
+    g_async_queue_unref(writer->queue);
+    g_free(writer->path);
+    g_free(writer);
+}
@@ -0,0 +1,30 @@
+#ifndef NETPULSE_LOG_H
+#define NETPULSE_LOG_H
+
+#include <glib.h>
+#include <stddef.h>
+
+#define LOG_RING_LINES 500
+#define LOG_FILE_MAX_BYTES (1024 * 1024)
+#define LOG_FILE_KEEP 3
+
+typedef struct {
+    char **lines;
+    guint capacity;
+    guint start;
+    guint count;
+    guint unflushed;
+} LogRing;
+
+typedef struct LogWriter LogWriter;
+
+void log_ring_init(LogRing *ring, guint capacity);
+void log_ring_free(LogRing *ring);
+void log_ring_push(LogRing *ring, const char *line);
+guint log_ring_take_unflushed(LogRing *ring, GString *out);
+
+LogWriter *log_writer_open(const char *path, size_t max_bytes, int keep_files);
+void log_writer_append(LogWriter *writer, const char *line);
+void log_writer_close(LogWriter *writer);
+
+#endif
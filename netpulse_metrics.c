@@ -0,0 +1,696 @@
+#define _POSIX_C_SOURCE 200809L
+#include "netpulse_metrics.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <glib-unix.h>
+#include <netdb.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "netpulse_monitor.h"
+
+#define METRICS_DEFAULT_HOST "127.0.0.1"
+#define METRICS_REQUEST_MAX 2048
+#define METRICS_CLIENT_TIMEOUT_SEC 5
+#define METRICS_IDLE_BUFFERS 4
+#define METRICS_CONTENT_TYPE "application/openmetrics-text; version=1.0.0; charset=utf-8"
+
+struct MetricsServer {
+    int fd;
+    guint accept_id;
+    MetricsRenderFunc render;
+    gpointer user_data;
+    GPtrArray *idle_buffers;
+    gsize last_size;
+    GList *connections;
+};
+
+typedef struct {
+    MetricsServer *server;
+    int fd;
+    guint io_id;
+    guint timeout_id;
+    char request[METRICS_REQUEST_MAX];
+    size_t request_len;
+    GString *response;
+    size_t sent;
+} MetricsConnection;
+
+static GString *take_buffer(MetricsServer *server) {
+    if (server->idle_buffers->len > 0) {
+        GString *buffer = g_ptr_array_remove_index_fast(server->idle_buffers, server->idle_buffers->len - 1);
+        g_string_truncate(buffer, 0);
+        return buffer;
+    }
+    /* Size new buffers from the last scrape, with headroom for targets added since. */
+    return g_string_sized_new(server->last_size + server->last_size / 4 + 4096);
+}
+
+static void release_buffer(MetricsServer *server, GString *buffer) {
+    if (server->idle_buffers->len < METRICS_IDLE_BUFFERS) {
+        g_ptr_array_add(server->idle_buffers, buffer);
+    } else {
+        g_string_free(buffer, TRUE);
+    }
+}
+
+static void close_connection(MetricsConnection *conn) {
+    MetricsServer *server = conn->server;
+    if (conn->io_id != 0) {
+        g_source_remove(conn->io_id);
+    }
+    if (conn->timeout_id != 0) {
+        g_source_remove(conn->timeout_id);
+    }
+    close(conn->fd);
+    if (conn->response != NULL) {
+        release_buffer(server, conn->response);
+    }
+    server->connections = g_list_remove(server->connections, conn);
+    g_free(conn);
+}
+
+static gboolean on_connection_timeout(gpointer user_data) {
+    MetricsConnection *conn = user_data;
+    conn->timeout_id = 0;
+    close_connection(conn);
+    return G_SOURCE_REMOVE;
+}
+
+static void build_response(MetricsConnection *conn) {
+    MetricsServer *server = conn->server;
+    conn->response = take_buffer(server);
+
+    char path[256] = "";
+    bool is_get = sscanf(conn->request, "GET %255s", path) == 1;
+    char *query = strchr(path, '?');
+    if (query != NULL) {
+        *query = '\0';
+    }
+
+    if (!is_get || strcmp(path, "/metrics") != 0) {
+        const char *body = is_get ? "Not found; scrape /metrics\n" : "Only GET is supported\n";
+        g_string_append_printf(conn->response,
+                               "HTTP/1.1 %s\r\nContent-Type: text/plain\r\nContent-Length: %zu\r\n"
+                               "Connection: close\r\n\r\n%s",
+                               is_get ? "404 Not Found" : "405 Method Not Allowed", strlen(body), body);
+        return;
+    }
+
+    /* Reserve room for the status line and headers, render the body after it, then fill the headers in. */
+    char header[256];
+    const size_t header_room = sizeof(header);
+    g_string_set_size(conn->response, header_room);
+    server->render(conn->response, server->user_data);
+    size_t body_len = conn->response->len - header_room;
+    server->last_size = MAX(server->last_size, conn->response->len);
+
+    int header_len = snprintf(header, sizeof(header),
+                              "HTTP/1.1 200 OK\r\nContent-Type: " METRICS_CONTENT_TYPE "\r\nContent-Length: %zu\r\n"
+                              "Connection: close\r\n\r\n",
+                              body_len);
+    size_t offset = header_room - (size_t)header_len;
+    memcpy(conn->response->str + offset, header, (size_t)header_len);
+    conn->sent = offset;
+}
+
+static gboolean on_connection_writable(gint fd, GIOCondition condition, gpointer user_data) {
+    MetricsConnection *conn = user_data;
+    if (condition & (G_IO_ERR | G_IO_HUP)) {
+        conn->io_id = 0;
+        close_connection(conn);
+        return G_SOURCE_REMOVE;
+    }
+
+    while (conn->sent < conn->response->len) {
+        ssize_t n = send(fd, conn->response->str + conn->sent, conn->response->len - conn->sent, MSG_NOSIGNAL);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return G_SOURCE_CONTINUE;
+        }
+        if (n <= 0) {
+            break;
+        }
+        conn->sent += (size_t)n;
+    }
+
+    conn->io_id = 0;
+    close_connection(conn);
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean on_connection_readable(gint fd, GIOCondition condition, gpointer user_data) {
+    MetricsConnection *conn = user_data;
+    if (condition & (G_IO_ERR | G_IO_HUP)) {
+        conn->io_id = 0;
+        close_connection(conn);
+        return G_SOURCE_REMOVE;
+    }
+
+    ssize_t n = recv(fd, conn->request + conn->request_len, sizeof(conn->request) - 1 - conn->request_len, 0);
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return G_SOURCE_CONTINUE;
+    }
+    if (n <= 0) {
+        conn->io_id = 0;
+        close_connection(conn);
+        return G_SOURCE_REMOVE;
+    }
+    conn->request_len += (size_t)n;
+    conn->request[conn->request_len] = '\0';
+
+    if (strstr(conn->request, "\r\n\r\n") == NULL && strstr(conn->request, "\n\n") == NULL &&
+        conn->request_len < sizeof(conn->request) - 1) {
+        return G_SOURCE_CONTINUE;
+    }
+
+    build_response(conn);
+    conn->io_id = g_unix_fd_add(fd, G_IO_OUT | G_IO_ERR | G_IO_HUP, on_connection_writable, conn);
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean on_accept(gint fd, GIOCondition condition, gpointer user_data) {
+    (void)condition;
+    MetricsServer *server = user_data;
+    for (;;) {
+        int client = accept(fd, NULL, NULL);
+        if (client < 0) {
+            break;
+        }
+        fcntl(client, F_SETFL, fcntl(client, F_GETFL) | O_NONBLOCK);
+        fcntl(client, F_SETFD, FD_CLOEXEC);
+
+        MetricsConnection *conn = g_new0(MetricsConnection, 1);
+        conn->server = server;
+        conn->fd = client;
+        conn->io_id = g_unix_fd_add(client, G_IO_IN | G_IO_ERR | G_IO_HUP, on_connection_readable, conn);
+        conn->timeout_id = g_timeout_add_seconds(METRICS_CLIENT_TIMEOUT_SEC, on_connection_timeout, conn);
+        server->connections = g_list_prepend(server->connections, conn);
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+static int open_listener(const char *listen_addr, char *error, size_t error_size) {
+    char host[256];
+    const char *port = listen_addr;
+    snprintf(host, sizeof(host), "%s", METRICS_DEFAULT_HOST);
+
+    const char *colon = strrchr(listen_addr, ':');
+    if (colon != NULL) {
+        const char *start = listen_addr;
+        size_t len = (size_t)(colon - listen_addr);
+        if (len >= 2 && start[0] == '[' && start[len - 1] == ']') {
+            start++;
+            len -= 2;
+        }
+        snprintf(host, sizeof(host), "%.*s", (int)len, start);
+        port = colon + 1;
+    }
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE | AI_NUMERICSERV;
+    struct addrinfo *result = NULL;
+    int rc = getaddrinfo(host[0] != '\0' ? host : NULL, port, &hints, &result);
+    if (rc != 0) {
+        snprintf(error, error_size, "%s", gai_strerror(rc));
+        return -1;
+    }
+
+    int fd = -1;
+    for (struct addrinfo *ai = result; ai != NULL; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, ai->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (bind(fd, ai->ai_addr, ai->ai_addrlen) == 0 && listen(fd, 16) == 0) {
+            break;
+        }
+        snprintf(error, error_size, "%s", strerror(errno));
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(result);
+    return fd;
+}
+
+MetricsServer *metrics_server_new(const char *listen_addr, MetricsRenderFunc render, gpointer user_data,
+                                  char *error, size_t error_size) {
+    snprintf(error, error_size, "no usable address");
+    int fd = open_listener(listen_addr, error, error_size);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    MetricsServer *server = g_new0(MetricsServer, 1);
+    server->fd = fd;
+    server->render = render;
+    server->user_data = user_data;
+    server->idle_buffers = g_ptr_array_new();
+    server->accept_id = g_unix_fd_add(fd, G_IO_IN, on_accept, server);
+    return server;
+}
+
+void metrics_server_free(MetricsServer *server) {
+    if (server == NULL) {
+        return;
+    }
+    while (server->connections != NULL) {
+        close_connection(server->connections->data);
+    }
+    g_source_remove(server->accept_id);
+    close(server->fd);
+    for (guint i = 0; i < server->idle_buffers->len; ++i) {
+        g_string_free(g_ptr_array_index(server->idle_buffers, i), TRUE);
+    }
+    g_ptr_array_free(server->idle_buffers, TRUE);
+    g_free(server);
+}
+
+/* Rendering below appends into the caller's buffer only: numbers go through a stack buffer
+   and label values are escaped in place, so a scrape does not allocate per series. */
+
+static void append_label_value(GString *out, const char *value) {
+    for (const char *p = value; *p != '\0'; ++p) {
+        if (*p == '\\' || *p == '"') {
+            g_string_append_c(out, '\\');
+            g_string_append_c(out, *p);
+        } else if (*p == '\n') {
+            g_string_append(out, "\\n");
+        } else {
+            g_string_append_c(out, *p);
+        }
+    }
+}
+
+static void append_number(GString *out, double value) {
+    char buf[G_ASCII_DTOSTR_BUF_SIZE];
+    g_string_append(out, g_ascii_formatd(buf, sizeof(buf), "%.9g", value));
+}
+
+static void append_uint(GString *out, guint64 value) {
+    char buf[24];
+    int len = snprintf(buf, sizeof(buf), "%" G_GUINT64_FORMAT, value);
+    g_string_append_len(out, buf, len);
+}
+
+static void append_family(GString *out, const char *name, const char *type, const char *unit, const char *help) {
+    g_string_append(out, "# TYPE ");
+    g_string_append(out, name);
+    g_string_append_c(out, ' ');
+    g_string_append(out, type);
+    g_string_append_c(out, '\n');
+    if (unit != NULL) {
+        g_string_append(out, "# UNIT ");
+        g_string_append(out, name);
+        g_string_append_c(out, ' ');
+        g_string_append(out, unit);
+        g_string_append_c(out, '\n');
+    }
+    g_string_append(out, "# HELP ");
+    g_string_append(out, name);
+    g_string_append_c(out, ' ');
+    g_string_append(out, help);
+    g_string_append_c(out, '\n');
+}
+
+static void append_target_series(GString *out, const char *name, const Target *target, const char *extra_label,
+                                 const char *extra_value) {
+    g_string_append(out, name);
+    g_string_append(out, "{target=\"");
+    append_label_value(out, target->display);
+    g_string_append(out, "\",host=\"");
+    append_label_value(out, target->host);
+    g_string_append_c(out, '"');
+    if (extra_label != NULL) {
+        g_string_append_c(out, ',');
+        g_string_append(out, extra_label);
+        g_string_append(out, "=\"");
+        g_string_append(out, extra_value);
+        g_string_append_c(out, '"');
+    }
+    g_string_append(out, "} ");
+}
+
+static void append_counter(GString *out, const char *name, const char *help, guint64 value) {
+    append_family(out, name, "counter", NULL, help);
+    g_string_append(out, name);
+    g_string_append(out, "_total ");
+    append_uint(out, value);
+    g_string_append_c(out, '\n');
+}
+
+static void append_gauge(GString *out, const char *name, const char *help, double value) {
+    append_family(out, name, "gauge", NULL, help);
+    g_string_append(out, name);
+    g_string_append_c(out, ' ');
+    append_number(out, value);
+    g_string_append_c(out, '\n');
+}
+
+/* Appends label="value" and the separator that follows it. */
+static void append_label(GString *out, const char *label, const char *value, char separator) {
+    g_string_append(out, label);
+    g_string_append(out, "=\"");
+    g_string_append(out, value);
+    g_string_append_c(out, '"');
+    g_string_append_c(out, separator);
+}
+
+static void append_histogram_bucket(GString *out, const char *name, const char *label, const char *value, int bucket,
+                                    guint64 count) {
+    g_string_append(out, name);
+    g_string_append(out, "_bucket{");
+    if (label != NULL) {
+        append_label(out, label, value, ',');
+    }
+    g_string_append(out, "le=\"");
+    if (bucket >= 0) {
+        append_number(out, duration_bucket_bound_ms(bucket) / 1000.0);
+    } else {
+        g_string_append(out, "+Inf");
+    }
+    g_string_append(out, "\"} ");
+    append_uint(out, count);
+    g_string_append_c(out, '\n');
+}
+
+static void append_histogram_total(GString *out, const char *name, const char *suffix, const char *label,
+                                   const char *value) {
+    g_string_append(out, name);
+    g_string_append(out, suffix);
+    if (label != NULL) {
+        g_string_append_c(out, '{');
+        append_label(out, label, value, '}');
+    }
+    g_string_append_c(out, ' ');
+}
+
+/* Exposes every other power-of-two bucket, 16 us to about 67 s, so the bucket set is fixed across scrapes. */
+static void append_histogram_series(GString *out, const char *name, const char *label, const char *value,
+                                    const DurationHistogram *histogram) {
+    for (int bucket = 4; bucket <= 26; bucket += 2) {
+        append_histogram_bucket(out, name, label, value, bucket, duration_histogram_count_below(histogram, bucket));
+    }
+    append_histogram_bucket(out, name, label, value, -1, histogram->total);
+    append_histogram_total(out, name, "_count", label, value);
+    append_uint(out, histogram->total);
+    g_string_append_c(out, '\n');
+    append_histogram_total(out, name, "_sum", label, value);
+    append_number(out, (double)histogram->sum_us / 1e6);
+    g_string_append_c(out, '\n');
+}
+
+static void append_diagnostics(GString *out, const Monitor *monitor) {
+    const MonitorDiagnostics *diag = &monitor->diag;
+    const MonitorCounters *counters = &monitor->counters;
+    append_family(out, "netpulse_tick_duration_seconds", "histogram", "seconds", "Time spent in each scheduler tick.");
+    append_histogram_series(out, "netpulse_tick_duration_seconds", NULL, NULL, &diag->tick);
+
+    append_family(out, "netpulse_probe_dispatch_delay_seconds", "histogram", "seconds",
+                  "Time from a probe's due tick until it was handed to its engine.");
+    for (int kind = 0; kind < PROBE_KIND_COUNT; ++kind) {
+        append_histogram_series(out, "netpulse_probe_dispatch_delay_seconds", "kind",
+                                probe_kind_name((ProbeKind)kind), &diag->dispatch[kind]);
+    }
+    append_family(out, "netpulse_probe_completion_seconds", "histogram", "seconds",
+                  "Time from dispatch until the probe result was recorded.");
+    for (int kind = 0; kind < PROBE_KIND_COUNT; ++kind) {
+        append_histogram_series(out, "netpulse_probe_completion_seconds", "kind", probe_kind_name((ProbeKind)kind),
+                                &diag->completion[kind]);
+    }
+    append_family(out, "netpulse_probes_in_flight", "gauge", NULL, "Probes dispatched and not yet recorded.");
+    for (int kind = 0; kind < PROBE_KIND_COUNT; ++kind) {
+        g_string_append(out, "netpulse_probes_in_flight{");
+        append_label(out, "kind", probe_kind_name((ProbeKind)kind), '}');
+        g_string_append_c(out, ' ');
+        append_number(out, diag->in_flight[kind]);
+        g_string_append_c(out, '\n');
+    }
+
+    append_counter(out, "netpulse_ticks_overrun", "Scheduler ticks that took longer than the tick period.",
+                   counters->ticks_overrun);
+    append_counter(out, "netpulse_ticks_late", "Scheduler ticks that fired more than half a period late.",
+                   counters->ticks_late);
+    append_counter(out, "netpulse_adaptive_backoffs", "Times a stable target's interval was doubled.",
+                   counters->adaptive_backoffs);
+    append_counter(out, "netpulse_adaptive_tightened", "Times a backed-off target returned to its base interval.",
+                   counters->adaptive_tightened);
+    append_counter(out, "netpulse_ticks_missed", "Wheel ticks caught up in a later tick.", counters->ticks_missed);
+    append_counter(out, "netpulse_spawn_errors", "ping commands that could not be started.", counters->spawn_errors);
+    append_counter(out, "netpulse_socket_errors", "Probe packets or sockets that failed locally.",
+                   counters->socket_errors);
+}
+
+static void append_alerts(GString *out, AlertPipeline *alerts) {
+    AlertCounters counters;
+    alert_pipeline_counters(alerts, &counters);
+    append_counter(out, "netpulse_alert_events", "Status change and flap events queued for the alert sinks.",
+                   counters.queued);
+    append_counter(out, "netpulse_alert_events_dropped", "Alert events dropped because the queue was full.",
+                   counters.dropped);
+    append_counter(out, "netpulse_alert_events_coalesced", "Alert events merged into an earlier event of the batch.",
+                   counters.coalesced);
+    append_counter(out, "netpulse_alert_batches", "Alert batches delivered to the sinks.", counters.batches);
+    append_counter(out, "netpulse_alert_delivery_failures", "Alert deliveries a sink did not accept.",
+                   counters.failures);
+}
+
+void monitor_render_metrics(GString *out, gpointer user_data) {
+    Monitor *monitor = user_data;
+    TargetStore *targets = &monitor->targets;
+    size_t count = target_store_count(targets);
+    static const char *const states[] = {"OFF", "GREEN", "AMBER", "RED"};
+    static const char *const quantiles[] = {"0.5", "0.95", "0.99"};
+    monitor->counters.scrapes++;
+
+    /* Window stats are computed once per target into a scratch array kept across scrapes. */
+    if (monitor->metrics_stats == NULL) {
+        monitor->metrics_stats = g_array_new(FALSE, FALSE, sizeof(TargetWindowStats));
+    }
+    g_array_set_size(monitor->metrics_stats, (guint)count);
+    TargetWindowStats *all_stats = (TargetWindowStats *)(void *)monitor->metrics_stats->data;
+    for (size_t i = 0; i < count; ++i) {
+        target_window_stats(target_store_at(targets, i), &all_stats[i]);
+    }
+
+    append_family(out, "netpulse_target_up", "gauge", NULL, "1 if the last probe of the target succeeded.");
+    for (size_t i = 0; i < count; ++i) {
+        const Target *target = target_store_at(targets, i);
+        if (target->history_total == 0) {
+            continue;
+        }
+        append_target_series(out, "netpulse_target_up", target, NULL, NULL);
+        g_string_append(out, target->last_success ? "1\n" : "0\n");
+    }
+
+    append_family(out, "netpulse_target_latency_seconds", "gauge", "seconds", "Latency of the last probe.");
+    for (size_t i = 0; i < count; ++i) {
+        const Target *target = target_store_at(targets, i);
+        if (target->has_latency) {
+            append_target_series(out, "netpulse_target_latency_seconds", target, NULL, NULL);
+            append_number(out, target->last_latency_ms / 1000.0);
+            g_string_append_c(out, '\n');
+        }
+    }
+
+    append_family(out, "netpulse_target_latency_avg_seconds", "gauge", "seconds",
+                  "Mean latency of successful probes over the window.");
+    for (size_t i = 0; i < count; ++i) {
+        const Target *target = target_store_at(targets, i);
+        const TargetWindowStats stats = all_stats[i];
+        if (stats.avg_latency_ms >= 0.0) {
+            append_target_series(out, "netpulse_target_latency_avg_seconds", target, "window", "60s");
+            append_number(out, stats.avg_latency_ms / 1000.0);
+            g_string_append_c(out, '\n');
+        }
+    }
+
+    append_family(out, "netpulse_target_latency_quantile_seconds", "gauge", "seconds",
+                  "Latency quantiles over the stats window.");
+    for (size_t i = 0; i < count; ++i) {
+        const Target *target = target_store_at(targets, i);
+        const TargetWindowStats stats = all_stats[i];
+        const double values[] = {stats.p50_ms, stats.p95_ms, stats.p99_ms};
+        for (size_t q = 0; q < G_N_ELEMENTS(values); ++q) {
+            if (values[q] >= 0.0) {
+                append_target_series(out, "netpulse_target_latency_quantile_seconds", target, "quantile",
+                                     quantiles[q]);
+                append_number(out, values[q] / 1000.0);
+                g_string_append_c(out, '\n');
+            }
+        }
+    }
+
+    append_family(out, "netpulse_target_jitter_seconds", "gauge", "seconds",
+                  "Mean difference between consecutive latencies over the stats window.");
+    for (size_t i = 0; i < count; ++i) {
+        const Target *target = target_store_at(targets, i);
+        const TargetWindowStats stats = all_stats[i];
+        if (stats.jitter_ms >= 0.0) {
+            append_target_series(out, "netpulse_target_jitter_seconds", target, NULL, NULL);
+            append_number(out, stats.jitter_ms / 1000.0);
+            g_string_append_c(out, '\n');
+        }
+    }
+
+    if (monitor->adaptive_max_ms > 0) {
+        append_family(out, "netpulse_target_interval_seconds", "gauge", "seconds",
+                      "Current probe interval, backed off for stable targets in adaptive mode.");
+        for (size_t i = 0; i < count; ++i) {
+            const Target *target = target_store_at(targets, i);
+            if (!target->remote) {
+                int base_ms = target->interval_ms > 0 ? target->interval_ms : monitor->interval_sec * 1000;
+                append_target_series(out, "netpulse_target_interval_seconds", target, NULL, NULL);
+                append_number(out, MAX(base_ms, target->adaptive_ms) / 1000.0);
+                g_string_append_c(out, '\n');
+            }
+        }
+    }
+
+    append_family(out, "netpulse_target_loss_ratio", "gauge", "ratio",
+                  "Fraction of echoes lost in the last burst or backend probe.");
+    for (size_t i = 0; i < count; ++i) {
+        const Target *target = target_store_at(targets, i);
+        if (target->has_loss) {
+            append_target_series(out, "netpulse_target_loss_ratio", target, NULL, NULL);
+            append_number(out, target->loss_pct / 100.0);
+            g_string_append_c(out, '\n');
+        }
+    }
+
+    append_family(out, "netpulse_target_probe_jitter_seconds", "gauge", "seconds",
+                  "RFC 3550 jitter within the last burst or backend probe.");
+    for (size_t i = 0; i < count; ++i) {
+        const Target *target = target_store_at(targets, i);
+        if (target->has_reported_jitter) {
+            append_target_series(out, "netpulse_target_probe_jitter_seconds", target, NULL, NULL);
+            append_number(out, target->reported_jitter_ms / 1000.0);
+            g_string_append_c(out, '\n');
+        }
+    }
+
+    append_family(out, "netpulse_target_burst_latency_seconds", "gauge", "seconds",
+                  "Fastest and slowest reply of the last burst.");
+    for (size_t i = 0; i < count; ++i) {
+        const Target *target = target_store_at(targets, i);
+        if (target->has_latency_range) {
+            append_target_series(out, "netpulse_target_burst_latency_seconds", target, "stat", "min");
+            append_number(out, target->latency_min_ms / 1000.0);
+            g_string_append_c(out, '\n');
+            append_target_series(out, "netpulse_target_burst_latency_seconds", target, "stat", "max");
+            append_number(out, target->latency_max_ms / 1000.0);
+            g_string_append_c(out, '\n');
+        }
+    }
+
+    append_family(out, "netpulse_target_resolve_seconds", "gauge", "seconds",
+                  "Duration of the last DNS lookup of the target host.");
+    for (size_t i = 0; i < count; ++i) {
+        const Target *target = target_store_at(targets, i);
+        if (target->has_resolve) {
+            append_target_series(out, "netpulse_target_resolve_seconds", target, NULL, NULL);
+            append_number(out, target->resolve_ms / 1000.0);
+            g_string_append_c(out, '\n');
+        }
+    }
+
+    append_family(out, "netpulse_target_http_phase_seconds", "gauge", "seconds",
+                  "Duration of each phase of the last HTTP probe.");
+    for (size_t i = 0; i < count; ++i) {
+        const Target *target = target_store_at(targets, i);
+        for (int phase = 0; phase < HTTP_PHASE_COUNT && target->has_phases; ++phase) {
+            append_target_series(out, "netpulse_target_http_phase_seconds", target, "phase",
+                                 http_phase_name((HttpPhase)phase));
+            append_number(out, target->phase_ms[phase] / 1000.0);
+            g_string_append_c(out, '\n');
+        }
+    }
+
+    append_family(out, "netpulse_target_uptime_ratio", "gauge", "ratio",
+                  "Fraction of successful probes over the window.");
+    for (size_t i = 0; i < count; ++i) {
+        const Target *target = target_store_at(targets, i);
+        const TargetWindowStats stats = all_stats[i];
+        if (stats.uptime_pct >= 0.0) {
+            append_target_series(out, "netpulse_target_uptime_ratio", target, "window", "60s");
+            append_number(out, stats.uptime_pct / 100.0);
+            g_string_append_c(out, '\n');
+        }
+    }
+    static const struct {
+        const char *label;
+        int span_sec;
+    } rollup_windows[] = {{"1h", 3600}, {"24h", 86400}, {"30d", 30 * 86400}};
+    time_t now = time(NULL);
+    for (size_t i = 0; i < count; ++i) {
+        Target *target = target_store_at(targets, i);
+        for (size_t w = 0; w < G_N_ELEMENTS(rollup_windows); ++w) {
+            RollupStats rollup;
+            if (target_rollup_stats(target, now, rollup_windows[w].span_sec, false, &rollup)) {
+                append_target_series(out, "netpulse_target_uptime_ratio", target, "window", rollup_windows[w].label);
+                append_number(out, rollup.uptime_pct / 100.0);
+                g_string_append_c(out, '\n');
+            }
+        }
+    }
+
+    append_family(out, "netpulse_target_status", "stateset", NULL, "Health light of the target.");
+    for (size_t i = 0; i < count; ++i) {
+        const Target *target = target_store_at(targets, i);
+        for (size_t s = 0; s < G_N_ELEMENTS(states); ++s) {
+            append_target_series(out, "netpulse_target_status", target, "netpulse_target_status", states[s]);
+            g_string_append(out, strcmp(target->status, states[s]) == 0 ? "1\n" : "0\n");
+        }
+    }
+
+    const MonitorCounters *counters = &monitor->counters;
+    append_gauge(out, "netpulse_targets", "Number of configured targets.", (double)count);
+    append_gauge(out, "netpulse_monitoring", "1 while monitoring is running.", monitor->monitoring ? 1.0 : 0.0);
+    append_gauge(out, "netpulse_probe_jobs_in_flight", "Probe jobs dispatched and not yet finished.",
+                 (double)monitor->jobs_in_flight);
+    append_gauge(out, "netpulse_probe_queue_depth", "Due probes waiting for the probe rate budget.",
+                 monitor->ready != NULL ? (double)g_queue_get_length(monitor->ready) : 0.0);
+    append_counter(out, "netpulse_ticks", "Scheduler ticks that dispatched probes.", counters->ticks);
+    append_counter(out, "netpulse_probes_skipped", "Due probes skipped because the previous one was still running.",
+                   counters->probes_skipped);
+    append_counter(out, "netpulse_probes_deferred", "Due probes held back by the probe rate budget.",
+                   counters->probes_deferred);
+    append_counter(out, "netpulse_probes", "Probe results recorded.", counters->probes);
+    append_counter(out, "netpulse_probe_failures", "Probe results recorded as failures.", counters->probe_failures);
+    append_counter(out, "netpulse_tcp_connect_refused", "TCP connect probes answered with a reset.",
+                   counters->tcp_refused);
+    append_counter(out, "netpulse_tcp_connect_timeouts", "TCP connect probes that got no answer in time.",
+                   counters->tcp_timeouts);
+    append_counter(out, "netpulse_metrics_scrapes", "Scrapes of this endpoint.", counters->scrapes);
+    if (monitor->dns != NULL) {
+        const DnsCounters *dns = dns_cache_counters(monitor->dns);
+        append_gauge(out, "netpulse_dns_lookups_pending", "DNS lookups still running.",
+                     (double)dns_cache_pending(monitor->dns));
+        append_counter(out, "netpulse_dns_lookups", "DNS lookups started.", dns->lookups);
+        append_counter(out, "netpulse_dns_lookup_failures", "DNS lookups that failed.", dns->failures);
+        append_counter(out, "netpulse_dns_cache_hits", "Probes sent to a cached address.", dns->hits);
+    }
+    append_diagnostics(out, monitor);
+    if (monitor->alerts != NULL) {
+        append_alerts(out, monitor->alerts);
+    }
+    if (monitor->relay_receiver != NULL) {
+        const RelayStats *relay = relay_receiver_stats(monitor->relay_receiver);
+        append_counter(out, "netpulse_relay_datagrams", "Datagrams received from agents.", relay->datagrams);
+        append_counter(out, "netpulse_relay_results", "Probe results received from agents.", relay->results);
+        append_counter(out, "netpulse_relay_announcements", "Target announcements received from agents.",
+                       relay->announcements);
+        append_counter(out, "netpulse_relay_malformed", "Agent datagrams that could not be decoded.", relay->malformed);
+        append_counter(out, "netpulse_relay_lost", "Agent datagrams missing from the sequence.", relay->lost);
+        append_counter(out, "netpulse_relay_unknown", "Agent results for targets not announced yet.",
+                       monitor->counters.relay_unknown);
+    }
+    g_string_append(out, "# EOF\n");
+}
@@ -0,0 +1,18 @@
+#ifndef NETPULSE_METRICS_H
+#define NETPULSE_METRICS_H
+
+#include <glib.h>
+#include <stddef.h>
+
+struct Monitor;
+
+typedef struct MetricsServer MetricsServer;
+typedef void (*MetricsRenderFunc)(GString *out, gpointer user_data);
+
+MetricsServer *metrics_server_new(const char *listen_addr, MetricsRenderFunc render, gpointer user_data,
+                                  char *error, size_t error_size);
+void metrics_server_free(MetricsServer *server);
+
+void monitor_render_metrics(GString *out, gpointer user_data);
+
+#endif
@@ -0,0 +1,272 @@
+#include "netpulse_model.h"
+
+#include <math.h>
+#include <string.h>
+
+typedef struct {
+    unsigned int id;
+    char status[8];
+    int latency_ms;
+    int avg_ms;
+    int uptime_pct;
+    int p50_tenths;
+    int p95_tenths;
+    int p99_tenths;
+    int jitter_tenths;
+    unsigned long history_total;
+} RowState;
+
+struct _TargetModel {
+    GObject parent_instance;
+    TargetStore *store;
+    GArray *rows;
+    gint stamp;
+};
+
+static void target_model_tree_model_init(GtkTreeModelIface *iface);
+
+G_DEFINE_TYPE_WITH_CODE(TargetModel, target_model, G_TYPE_OBJECT,
+                        G_IMPLEMENT_INTERFACE(GTK_TYPE_TREE_MODEL, target_model_tree_model_init))
+
+/* Rounded the same way the cells are formatted ("%.0f"), so a row is only
+   reported as changed when its text would actually differ. */
+static int rounded_or_none(double value, bool present) {
+    return present ? (int)rint(value) : -1;
+}
+
+static void capture_row(RowState *state, Target *target) {
+    TargetWindowStats stats;
+    target_window_stats(target, &stats);
+
+    memset(state, 0, sizeof(*state));
+    state->id = target->id;
+    memcpy(state->status, target->status, sizeof(state->status));
+    state->latency_ms = rounded_or_none(target->last_latency_ms, target->has_latency);
+    state->avg_ms = rounded_or_none(stats.avg_latency_ms, stats.avg_latency_ms >= 0.0);
+    state->uptime_pct = rounded_or_none(stats.uptime_pct, stats.uptime_pct >= 0.0);
+    state->p50_tenths = rounded_or_none(stats.p50_ms * 10.0, stats.p50_ms >= 0.0);
+    state->p95_tenths = rounded_or_none(stats.p95_ms * 10.0, stats.p95_ms >= 0.0);
+    state->p99_tenths = rounded_or_none(stats.p99_ms * 10.0, stats.p99_ms >= 0.0);
+    state->jitter_tenths = rounded_or_none(stats.jitter_ms * 10.0, stats.jitter_ms >= 0.0);
+    /* A new sample moves the sparkline even when none of the text changes. */
+    state->history_total = target->history_total;
+}
+
+static Target *iter_target(TargetModel *model, GtkTreeIter *iter) {
+    guint index = GPOINTER_TO_UINT(iter->user_data);
+    if (iter->stamp != model->stamp || index >= target_store_count(model->store)) {
+        return NULL;
+    }
+    return target_store_at(model->store, index);
+}
+
+static bool set_iter(TargetModel *model, GtkTreeIter *iter, guint index) {
+    if (index >= model->rows->len) {
+        iter->stamp = 0;
+        return false;
+    }
+    iter->stamp = model->stamp;
+    iter->user_data = GUINT_TO_POINTER(index);
+    iter->user_data2 = NULL;
+    iter->user_data3 = NULL;
+    return true;
+}
+
+static GtkTreeModelFlags model_get_flags(GtkTreeModel *tree_model) {
+    (void)tree_model;
+    return GTK_TREE_MODEL_LIST_ONLY;
+}
+
+static gint model_get_n_columns(GtkTreeModel *tree_model) {
+    (void)tree_model;
+    return TARGET_COLUMN_COUNT;
+}
+
+static GType model_get_column_type(GtkTreeModel *tree_model, gint column) {
+    (void)tree_model;
+    if (column == TARGET_COLUMN_TARGET) {
+        return G_TYPE_POINTER;
+    }
+    return column == TARGET_COLUMN_ID ? G_TYPE_UINT : G_TYPE_STRING;
+}
+
+static gboolean model_get_iter(GtkTreeModel *tree_model, GtkTreeIter *iter, GtkTreePath *path) {
+    if (gtk_tree_path_get_depth(path) != 1) {
+        return FALSE;
+    }
+    return set_iter(NETPULSE_TARGET_MODEL(tree_model), iter, (guint)gtk_tree_path_get_indices(path)[0]);
+}
+
+static GtkTreePath *model_get_path(GtkTreeModel *tree_model, GtkTreeIter *iter) {
+    (void)tree_model;
+    return gtk_tree_path_new_from_indices((gint)GPOINTER_TO_UINT(iter->user_data), -1);
+}
+
+static void model_get_value(GtkTreeModel *tree_model, GtkTreeIter *iter, gint column, GValue *value) {
+    TargetModel *model = NETPULSE_TARGET_MODEL(tree_model);
+    Target *target = iter_target(model, iter);
+
+    if (column == TARGET_COLUMN_ID) {
+        g_value_init(value, G_TYPE_UINT);
+        g_value_set_uint(value, target != NULL ? target->id : 0);
+        return;
+    }
+    if (column == TARGET_COLUMN_TARGET) {
+        g_value_init(value, G_TYPE_POINTER);
+        g_value_set_pointer(value, target);
+        return;
+    }
+
+    g_value_init(value, G_TYPE_STRING);
+    if (target == NULL) {
+        return;
+    }
+
+    if (column == TARGET_COLUMN_DISPLAY) {
+        g_value_set_static_string(value, target->display);
+        return;
+    }
+    if (column == TARGET_COLUMN_STATUS) {
+        g_value_set_static_string(value, target->status);
+        return;
+    }
+
+    if (column == TARGET_COLUMN_PERCENTILES || column == TARGET_COLUMN_JITTER) {
+        char percentile_text[64];
+        char jitter_text[32];
+        compute_tail_stats(target, percentile_text, sizeof(percentile_text), jitter_text, sizeof(jitter_text));
+        g_value_set_string(value, column == TARGET_COLUMN_PERCENTILES ? percentile_text : jitter_text);
+        return;
+    }
+
+    char latency_text[32];
+    char avg_text[32];
+    char uptime_text[32];
+    compute_stats(target, latency_text, sizeof(latency_text), avg_text, sizeof(avg_text), uptime_text,
+                  sizeof(uptime_text));
+    if (column == TARGET_COLUMN_LATENCY) {
+        g_value_set_string(value, latency_text);
+    } else if (column == TARGET_COLUMN_AVG) {
+        g_value_set_string(value, avg_text);
+    } else {
+        g_value_set_string(value, uptime_text);
+    }
+}
+
+static gboolean model_iter_next(GtkTreeModel *tree_model, GtkTreeIter *iter) {
+    return set_iter(NETPULSE_TARGET_MODEL(tree_model), iter, GPOINTER_TO_UINT(iter->user_data) + 1);
+}
+
+static gboolean model_iter_children(GtkTreeModel *tree_model, GtkTreeIter *iter, GtkTreeIter *parent) {
+    if (parent != NULL) {
+        return FALSE;
+    }
+    return set_iter(NETPULSE_TARGET_MODEL(tree_model), iter, 0);
+}
+
+static gboolean model_iter_has_child(GtkTreeModel *tree_model, GtkTreeIter *iter) {
+    (void)tree_model;
+    (void)iter;
+    return FALSE;
+}
+
+static gint model_iter_n_children(GtkTreeModel *tree_model, GtkTreeIter *iter) {
+    return iter == NULL ? (gint)NETPULSE_TARGET_MODEL(tree_model)->rows->len : 0;
+}
+
+static gboolean model_iter_nth_child(GtkTreeModel *tree_model, GtkTreeIter *iter, GtkTreeIter *parent, gint n) {
+    if (parent != NULL || n < 0) {
+        return FALSE;
+    }
+    return set_iter(NETPULSE_TARGET_MODEL(tree_model), iter, (guint)n);
+}
+
+static gboolean model_iter_parent(GtkTreeModel *tree_model, GtkTreeIter *iter, GtkTreeIter *child) {
+    (void)tree_model;
+    (void)iter;
+    (void)child;
+    return FALSE;
+}
+
+static void target_model_tree_model_init(GtkTreeModelIface *iface) {
+    iface->get_flags = model_get_flags;
+    iface->get_n_columns = model_get_n_columns;
+    iface->get_column_type = model_get_column_type;
+    iface->get_iter = model_get_iter;
+    iface->get_path = model_get_path;
+    iface->get_value = model_get_value;
+    iface->iter_next = model_iter_next;
+    iface->iter_children = model_iter_children;
+    iface->iter_has_child = model_iter_has_child;
+    iface->iter_n_children = model_iter_n_children;
+    iface->iter_nth_child = model_iter_nth_child;
+    iface->iter_parent = model_iter_parent;
+}
+
+static void target_model_finalize(GObject *object) {
+    TargetModel *model = NETPULSE_TARGET_MODEL(object);
+    g_array_free(model->rows, TRUE);
+    G_OBJECT_CLASS(target_model_parent_class)->finalize(object);
+}
+
+static void target_model_class_init(TargetModelClass *klass) {
+    G_OBJECT_CLASS(klass)->finalize = target_model_finalize;
+}
+
+static void target_model_init(TargetModel *model) {
+    model->rows = g_array_new(FALSE, TRUE, sizeof(RowState));
+    model->stamp = g_random_int();
+}
+
+TargetModel *target_model_new(TargetStore *store) {
+    TargetModel *model = g_object_new(NETPULSE_TYPE_TARGET_MODEL, NULL);
+    model->store = store;
+    target_model_sync(model);
+    return model;
+}
+
+/* Reconciles the rows the view knows about with the store. The store removes
+   by swapping the last target into the hole, so a removal shows up here as the
+   last row disappearing plus a changed id at the removed index. */
+void target_model_sync(TargetModel *model) {
+    GtkTreeModel *tree_model = GTK_TREE_MODEL(model);
+    guint count = (guint)target_store_count(model->store);
+
+    while (model->rows->len > count) {
+        guint last = model->rows->len - 1;
+        g_array_set_size(model->rows, last);
+        model->stamp++;
+        GtkTreePath *path = gtk_tree_path_new_from_indices((gint)last, -1);
+        gtk_tree_model_row_deleted(tree_model, path);
+        gtk_tree_path_free(path);
+    }
+
+    for (guint i = 0; i < model->rows->len; ++i) {
+        RowState state;
+        capture_row(&state, target_store_at(model->store, i));
+        RowState *cached = &g_array_index(model->rows, RowState, i);
+        if (memcmp(cached, &state, sizeof(state)) == 0) {
+            continue;
+        }
+        *cached = state;
+
+        GtkTreeIter iter;
+        set_iter(model, &iter, i);
+        GtkTreePath *path = gtk_tree_path_new_from_indices((gint)i, -1);
+        gtk_tree_model_row_changed(tree_model, path, &iter);
+        gtk_tree_path_free(path);
+    }
+
+    while (model->rows->len < count) {
+        guint index = model->rows->len;
+        RowState state;
+        capture_row(&state, target_store_at(model->store, index));
+        g_array_append_val(model->rows, state);
+
+        GtkTreeIter iter;
+        set_iter(model, &iter, index);
+        GtkTreePath *path = gtk_tree_path_new_from_indices((gint)index, -1);
+        gtk_tree_model_row_inserted(tree_model, path, &iter);
+        gtk_tree_path_free(path);
+    }
+}
@@ -0,0 +1,27 @@
+#ifndef NETPULSE_MODEL_H
+#define NETPULSE_MODEL_H
+
+#include <gtk/gtk.h>
+
+#include "netpulse_targets.h"
+
+typedef enum {
+    TARGET_COLUMN_DISPLAY,
+    TARGET_COLUMN_STATUS,
+    TARGET_COLUMN_LATENCY,
+    TARGET_COLUMN_AVG,
+    TARGET_COLUMN_UPTIME,
+    TARGET_COLUMN_PERCENTILES,
+    TARGET_COLUMN_JITTER,
+    TARGET_COLUMN_ID,
+    TARGET_COLUMN_TARGET,
+    TARGET_COLUMN_COUNT,
+} TargetColumn;
+
+#define NETPULSE_TYPE_TARGET_MODEL (target_model_get_type())
+G_DECLARE_FINAL_TYPE(TargetModel, target_model, NETPULSE, TARGET_MODEL, GObject)
+
+TargetModel *target_model_new(TargetStore *store);
+void target_model_sync(TargetModel *model);
+
+#endif
@@ -0,0 +1,1991 @@
+#define _POSIX_C_SOURCE 200809L
+#include "netpulse_monitor.h"
+
+#include <getopt.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+
+static const int PROBE_TIMEOUT_SEC = 3;
+
+typedef enum {
+    PROBE_JOB_PING,
+    PROBE_JOB_BACKEND,
+    PROBE_JOB_BACKEND_BATCH,
+    PROBE_JOB_NATIVE_BATCH,
+    PROBE_JOB_TCP_BATCH,
+    PROBE_JOB_HTTP,
+} ProbeJobKind;
+
+typedef struct {
+    unsigned int target_id;
+    char host[256];
+    char address[DNS_ADDRESS_LEN];
+    char display[256];
+    TargetProbe probe;
+    int port;
+    bool success;
+    double latency_ms;
+    bool has_latency;
+    const char *failure;
+    double loss_pct;
+    bool has_loss;
+    double reported_jitter_ms;
+    bool has_reported_jitter;
+    int samples;
+    double latency_min_ms;
+    double latency_max_ms;
+    bool has_latency_range;
+    double phase_ms[HTTP_PHASE_COUNT];
+    bool has_phases;
+    int phase_limit_ms[HTTP_PHASE_COUNT];
+    int timeout_ms;
+    ProbeKind kind;
+    int64_t due_ns;
+    int64_t dispatched_ns;
+    int64_t finished_ns;
+} ProbeTask;
+
+typedef struct {
+    ProbeJobKind kind;
+    char backend_url[512];
+    ProbeTask *tasks;
+    int task_count;
+    int burst;
+    int burst_spacing_ms;
+    int spawn_errors;
+    int socket_errors;
+} ProbeJob;
+
+typedef struct {
+    Monitor *monitor;
+    ProbeJob *job;
+} BackendRequest;
+
+typedef struct {
+    Monitor *monitor;
+    ProbeJob *job;
+    GHashTable *pending;
+    GString *buffer;
+} BackendBatch;
+
+void monitor_log(Monitor *monitor, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    char msg[512];
+    vsnprintf(msg, sizeof(msg), fmt, args);
+    va_end(args);
+
+    time_t now = time(NULL);
+    struct tm *tm_now = localtime(&now);
+    char ts[32];
+    strftime(ts, sizeof(ts), "%H:%M:%S", tm_now);
+
+    if (monitor->log_writer != NULL) {
+        char date[16];
+        strftime(date, sizeof(date), "%Y-%m-%d", tm_now);
+        char line[640];
+        snprintf(line, sizeof(line), "%s %s %s\n", date, ts, msg);
+        log_writer_append(monitor->log_writer, line);
+    }
+
+    if (monitor->callbacks.log != NULL) {
+        monitor->callbacks.log(ts, msg, monitor->callbacks.user_data);
+    } else {
+        fprintf(stderr, "[%s] %s\n", ts, msg);
+    }
+}
+
+/* Finds the round trip of the next reply line at or after *p and advances *p past it. */
+static bool next_ping_time(const char **p, double *rtt_ms) {
+    for (;;) {
+        const char *equal = strstr(*p, "time=");
+        const char *below = strstr(*p, "time<");
+        const char *hit = equal == NULL || (below != NULL && below < equal) ? below : equal;
+        if (hit == NULL) {
+            return false;
+        }
+        *p = hit + 5;
+        if (g_ascii_isdigit(hit[5])) {
+            char *endptr = NULL;
+            *rtt_ms = g_ascii_strtod(hit + 5, &endptr);
+            *p = endptr;
+            return true;
+        }
+    }
+}
+
+/* The monitor ignores SIGPIPE; ping gets the default action back like any program started from a shell. */
+static void restore_sigpipe(gpointer user_data) {
+    (void)user_data;
+    signal(SIGPIPE, SIG_DFL);
+}
+
+/* Sends count echoes through the system ping and summarizes the reply lines it prints, in order. Returns
+   false when ping could not be started. */
+static bool run_ping(const char *host, int timeout_ms, int count, int spacing_ms, IcmpProbe *probe) {
+    char count_arg[16];
+    char wait_arg[16];
+    char interval[G_ASCII_DTOSTR_BUF_SIZE];
+    snprintf(count_arg, sizeof(count_arg), "%d", count);
+    snprintf(wait_arg, sizeof(wait_arg), "%d", (timeout_ms + 999) / 1000);
+    /* Unprivileged ping refuses intervals below 200 ms. */
+    g_ascii_formatd(interval, sizeof(interval), "%.3f", MAX(spacing_ms, 200) / 1000.0);
+    gchar *argv[] = {"ping", "-c", count_arg, "-W", wait_arg, (gchar *)host, NULL, NULL, NULL};
+    if (count > 1) {
+        argv[5] = "-i";
+        argv[6] = interval;
+        argv[7] = (gchar *)host;
+    }
+
+    gchar *stdout_data = NULL;
+    gchar *stderr_data = NULL;
+    gint exit_status = 1;
+    GError *error = NULL;
+
+    gboolean ok = g_spawn_sync(NULL, argv, NULL, G_SPAWN_SEARCH_PATH, restore_sigpipe, NULL, &stdout_data,
+                               &stderr_data, &exit_status, &error);
+    if (!ok && error != NULL) {
+        g_error_free(error);
+    }
+
+    double *rtt_ms = g_new(double, count);
+    size_t replies = 0;
+    const char *p = ok && stdout_data != NULL ? stdout_data : "";
+    while (replies < (size_t)count && next_ping_time(&p, &rtt_ms[replies])) {
+        replies++;
+    }
+    icmp_probe_summarize(probe, rtt_ms, replies, count);
+    /* Some ping builds print no per-reply time; a clean exit still counts as a reply. */
+    if (ok && exit_status == 0 && !probe->success) {
+        probe->success = true;
+    }
+
+    g_free(rtt_ms);
+    g_free(stdout_data);
+    g_free(stderr_data);
+    return ok;
+}
+
+static bool is_valid_probe_url(const char *probe_url) {
+    if (probe_url == NULL || probe_url[0] == '\0') {
+        return false;
+    }
+    return g_str_has_prefix(probe_url, "http://") || g_str_has_prefix(probe_url, "https://");
+}
+
+static void apply_probe_result(ProbeTask *task, const ProbeResult *result) {
+    task->success = result->ok;
+    task->latency_ms = result->latency_ms;
+    task->has_latency = result->has_latency;
+    task->loss_pct = result->loss_pct;
+    task->has_loss = result->has_loss;
+    task->reported_jitter_ms = result->jitter_ms;
+    task->has_reported_jitter = result->has_jitter;
+    task->samples = result->samples;
+    if (!result->ok && (result->error[0] != '\0' || result->error_code != 0)) {
+        task->failure = "backend";
+    }
+}
+
+/* A burst adds loss, jitter and the latency range to the mean; a single echo stays a plain sample. */
+static void apply_icmp_probe(ProbeTask *task, const IcmpProbe *probe, int burst) {
+    task->success = probe->success;
+    task->latency_ms = probe->latency_ms;
+    task->has_latency = probe->has_latency;
+    if (burst <= 1 || probe->sent_count == 0) {
+        return;
+    }
+    task->samples = probe->sent_count;
+    task->loss_pct = 100.0 * (probe->sent_count - probe->received) / probe->sent_count;
+    task->has_loss = true;
+    task->reported_jitter_ms = probe->jitter_ms;
+    task->has_reported_jitter = probe->has_jitter;
+    task->latency_min_ms = probe->min_ms;
+    task->latency_max_ms = probe->max_ms;
+    task->has_latency_range = probe->received > 0;
+}
+
+static gchar *build_backend_url(const char *backend_url, const char *target) {
+    gchar *escaped = g_uri_escape_string(target, NULL, FALSE);
+    gchar *url = g_strdup_printf("%s%ctarget=%s", backend_url, strchr(backend_url, '?') != NULL ? '&' : '?', escaped);
+    g_free(escaped);
+    return url;
+}
+
+bool monitor_save_config(const Monitor *monitor, const char *path) {
+    FILE *f = fopen(path, "w");
+    if (f == NULL) {
+        return false;
+    }
+
+    char number[G_ASCII_DTOSTR_BUF_SIZE];
+    fprintf(f, "# auto_start=%d\n", monitor->auto_start ? 1 : 0);
+    fprintf(f, "# probe_backend=%s\n", monitor->probe_backend_url);
+    if (monitor->probe_rate > 0.0) {
+        fprintf(f, "# probe_rate=%s\n", g_ascii_formatd(number, sizeof(number), "%g", monitor->probe_rate));
+    }
+    if (monitor->burst_count > 1) {
+        fprintf(f, "# burst=%d\n", monitor->burst_count);
+    }
+    if (monitor->burst_spacing_ms > 0) {
+        fprintf(f, "# burst_spacing_ms=%d\n", monitor->burst_spacing_ms);
+    }
+    if (monitor->adaptive_max_ms > 0) {
+        fprintf(f, "# adaptive_max_sec=%d\n", monitor->adaptive_max_ms / 1000);
+    }
+    for (size_t i = 0; i < target_store_count(&monitor->targets); ++i) {
+        const Target *target = target_store_at(&monitor->targets, i);
+        if (target->remote) {
+            continue;
+        }
+        fputs(target->display, f);
+        if (target->interval_ms > 0) {
+            fprintf(f, " interval=%s", g_ascii_formatd(number, sizeof(number), "%g", target->interval_ms / 1000.0));
+        }
+        if (target->timeout_ms > 0) {
+            fprintf(f, " timeout=%s", g_ascii_formatd(number, sizeof(number), "%g", target->timeout_ms / 1000.0));
+        }
+        for (int phase = 0; phase < HTTP_PHASE_COUNT; ++phase) {
+            if (target->phase_limit_ms[phase] > 0) {
+                fprintf(f, " max_%s=%s", http_phase_name((HttpPhase)phase),
+                        g_ascii_formatd(number, sizeof(number), "%g", target->phase_limit_ms[phase] / 1000.0));
+            }
+        }
+        fputc('\n', f);
+    }
+
+    fclose(f);
+    return true;
+}
+
+static void replay_history(Monitor *monitor, Target *target) {
+    HistoryRecord records[HISTORY_SIZE];
+    size_t count = history_file_replay(&monitor->history, (uint32_t)target->history_slot, records, HISTORY_SIZE);
+    time_t now = time(NULL);
+    int64_t now_ns = monotonic_ns();
+    for (size_t i = 0; i < count; ++i) {
+        /* The file keeps wall-clock seconds; place each sample at the same age on the monotonic clock. */
+        int64_t mono_ns = now_ns - (int64_t)difftime(now, (time_t)records[i].timestamp) * 1000000000;
+        add_history_at(target, (time_t)records[i].timestamp, mono_ns, records[i].success, records[i].latency_ms,
+                       records[i].has_latency);
+    }
+    if (count == 0) {
+        return;
+    }
+
+    /* Only resume the light and latency if the last sample is still inside the 60 s window. */
+    if (difftime(now, (time_t)records[count - 1].timestamp) <= target->window60.span_sec) {
+        compute_status(target);
+    } else {
+        target->has_latency = false;
+    }
+}
+
+static void attach_history(Monitor *monitor, Target *target) {
+    if (!monitor->history_ready) {
+        return;
+    }
+
+    gchar *key = g_strdup(target->key);
+    gpointer slot;
+    if (g_hash_table_lookup_extended(monitor->history_slots, key, NULL, &slot)) {
+        target->history_slot = GPOINTER_TO_INT(slot);
+        replay_history(monitor, target);
+        g_free(key);
+        return;
+    }
+
+    int claimed = history_file_claim(&monitor->history, key);
+    if (claimed < 0) {
+        g_free(key);
+        return;
+    }
+    target->history_slot = claimed;
+    g_hash_table_insert(monitor->history_slots, key, GINT_TO_POINTER(claimed));
+}
+
+static gboolean on_history_sync(gpointer user_data) {
+    Monitor *monitor = user_data;
+    history_file_sync(&monitor->history, false);
+    return G_SOURCE_CONTINUE;
+}
+
+static void open_history(Monitor *monitor, const char *path) {
+    if (!history_file_open(&monitor->history, path)) {
+        monitor_log(monitor, "Could not open history file %s (missing, locked or incompatible); history is not kept.",
+                    path);
+        return;
+    }
+
+    monitor->history_ready = true;
+    monitor->history_slots = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    for (uint32_t slot = 0; slot < monitor->history.slot_count; ++slot) {
+        const char *host = history_file_slot_host(&monitor->history, slot);
+        if (host != NULL) {
+            g_hash_table_insert(monitor->history_slots, g_strdup(host), GINT_TO_POINTER((int)slot));
+        }
+    }
+    monitor->history_sync_id = g_timeout_add_seconds(HISTORY_SYNC_SEC, on_history_sync, monitor);
+}
+
+/* Frees the slots of hosts that are no longer configured once startup has loaded every target. */
+static void prune_history(Monitor *monitor) {
+    if (!monitor->history_ready) {
+        return;
+    }
+
+    GHashTableIter iter;
+    gpointer key;
+    gpointer slot;
+    g_hash_table_iter_init(&iter, monitor->history_slots);
+    while (g_hash_table_iter_next(&iter, &key, &slot)) {
+        if (target_store_lookup_key(&monitor->targets, key) == NULL) {
+            history_file_release(&monitor->history, (uint32_t)GPOINTER_TO_INT(slot));
+            g_hash_table_iter_remove(&iter);
+        }
+    }
+}
+
+static DnsState resolve_target(Monitor *monitor, Target *target);
+static void remove_target(Monitor *monitor, Target *target);
+static void schedule_updated(Monitor *monitor);
+
+static int base_interval_ms(const Monitor *monitor, const Target *target) {
+    return target->interval_ms > 0 ? target->interval_ms : monitor->interval_sec * 1000;
+}
+
+static int target_interval_ms(const Monitor *monitor, const Target *target) {
+    int base_ms = base_interval_ms(monitor, target);
+    return target->adaptive_ms > base_ms ? target->adaptive_ms : base_ms;
+}
+
+static uint64_t current_tick(void) {
+    return (uint64_t)(monotonic_ns() / ((int64_t)WHEEL_TICK_MS * 1000000));
+}
+
+/* Arms the target's next probe at its nominal due tick plus up to 10% of the interval of jitter.
+   The nominal schedule advances by whole intervals, so the jitter never accumulates into drift. */
+static void schedule_target(Monitor *monitor, Target *target, uint64_t nominal_tick) {
+    uint64_t interval_ticks = MAX(1, target_interval_ms(monitor, target) / WHEEL_TICK_MS);
+    uint64_t jitter = interval_ticks >= 10 ? (uint64_t)g_random_int_range(0, (gint32)(interval_ticks / 10)) : 0;
+    target->next_due_tick = nominal_tick;
+    target->timer.data = target;
+    timer_wheel_schedule(&monitor->wheel, &target->timer, nominal_tick + jitter);
+}
+
+Target *monitor_add_target(Monitor *monitor, const char *raw_target, bool log_result) {
+    TargetAddResult result;
+    Target *t = target_store_add(&monitor->targets, raw_target, &result);
+    if (t == NULL) {
+        if (log_result && result == TARGET_ADD_INVALID) {
+            monitor_log(monitor, "Invalid target: %s", raw_target);
+        } else if (log_result && result == TARGET_ADD_DUPLICATE) {
+            monitor_log(monitor, "Skipping duplicate target: %s", raw_target);
+        }
+        return NULL;
+    }
+
+    attach_history(monitor, t);
+    if (monitor->monitoring) {
+        uint64_t interval_ticks = MAX(1, target_interval_ms(monitor, t) / WHEEL_TICK_MS);
+        schedule_target(monitor, t, monitor->wheel.now + (uint64_t)g_random_int_range(0, (gint32)interval_ticks));
+        resolve_target(monitor, t);
+    }
+    if (log_result) {
+        monitor_log(monitor, "Added target: %s", t->display);
+    }
+    return t;
+}
+
+void monitor_remove_target(Monitor *monitor, unsigned int id) {
+    Target *target = target_store_lookup_id(&monitor->targets, id);
+    if (target == NULL) {
+        return;
+    }
+    monitor_log(monitor, "Removed target: %s", target->display);
+    remove_target(monitor, target);
+}
+
+void monitor_set_backend_url(Monitor *monitor, const char *url) {
+    snprintf(monitor->probe_backend_url, sizeof(monitor->probe_backend_url), "%s", url != NULL ? url : "");
+}
+
+static int parse_seconds_ms(const char *value) {
+    char *end = NULL;
+    double seconds = g_ascii_strtod(value, &end);
+    if (end == value || *end != '\0' || seconds <= 0.0) {
+        return -1;
+    }
+    return (int)(seconds * 1000.0 + 0.5);
+}
+
+static int phase_limit_option(const char *option) {
+    for (int phase = 0; phase < HTTP_PHASE_COUNT; ++phase) {
+        const char *name = http_phase_name((HttpPhase)phase);
+        size_t len = strlen(name);
+        if (strncmp(option, "max_", 4) == 0 && strncmp(option + 4, name, len) == 0 && option[4 + len] == '=') {
+            return phase;
+        }
+    }
+    return -1;
+}
+
+/* Per-target settings from a config line; zero means the monitor default. */
+typedef struct {
+    int interval_ms;
+    int timeout_ms;
+    int phase_limit_ms[HTTP_PHASE_COUNT];
+} TargetSettings;
+
+/* The target a line of the watched file asks for, keyed by target key in Monitor.config_specs. owned is set
+   when the file added the target, not the command line, the GUI or the saved configuration before it, and
+   only owned targets are removed when their line goes away. */
+typedef struct {
+    gchar *raw;
+    TargetSettings settings;
+    bool owned;
+} TargetSpec;
+
+static void free_target_spec(gpointer data) {
+    TargetSpec *spec = data;
+    g_free(spec->raw);
+    g_free(spec);
+}
+
+static GHashTable *new_spec_table(void) {
+    return g_hash_table_new_full(g_str_hash, g_str_equal, g_free, free_target_spec);
+}
+
+/* A target line is the target followed by optional "interval=<sec>" and "timeout=<sec>" settings, and for
+   HTTP targets "max_dns=", "max_connect=", "max_tls=" or "max_ttfb=" phase limits in seconds. Returns the
+   target, or NULL for a blank line. */
+static char *parse_target_line(Monitor *monitor, char *line, TargetSettings *settings) {
+    memset(settings, 0, sizeof(*settings));
+    char *save = NULL;
+    char *raw = strtok_r(line, " \t", &save);
+    if (raw == NULL) {
+        return NULL;
+    }
+
+    char *option;
+    while ((option = strtok_r(NULL, " \t", &save)) != NULL) {
+        char *value = strchr(option, '=');
+        int ms = value != NULL ? parse_seconds_ms(value + 1) : -1;
+        if (ms > 0 && strncmp(option, "interval=", 9) == 0) {
+            settings->interval_ms = ms;
+        } else if (ms > 0 && strncmp(option, "timeout=", 8) == 0) {
+            settings->timeout_ms = ms;
+        } else if (ms > 0 && phase_limit_option(option) >= 0) {
+            settings->phase_limit_ms[phase_limit_option(option)] = ms;
+        } else {
+            monitor_log(monitor, "Ignoring setting \"%s\" for %s", option, raw);
+        }
+    }
+    return raw;
+}
+
+static bool target_settings_equal(const Target *target, const TargetSettings *settings) {
+    if (target->interval_ms != settings->interval_ms || target->timeout_ms != settings->timeout_ms) {
+        return false;
+    }
+    for (int phase = 0; phase < HTTP_PHASE_COUNT; ++phase) {
+        if (target->phase_limit_ms[phase] != settings->phase_limit_ms[phase]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* A startup load only overrides what the line sets, so a later file can add to an earlier one; a reload
+   replaces every setting so removing one from the line restores the default. */
+static void apply_target_settings(Monitor *monitor, Target *target, const TargetSettings *settings, bool replace) {
+    int old_interval_ms = target->interval_ms;
+    if (replace || settings->interval_ms > 0) {
+        target->interval_ms = settings->interval_ms;
+    }
+    if (replace || settings->timeout_ms > 0) {
+        target->timeout_ms = settings->timeout_ms;
+    }
+    for (int phase = 0; phase < HTTP_PHASE_COUNT; ++phase) {
+        if (replace || settings->phase_limit_ms[phase] > 0) {
+            target->phase_limit_ms[phase] = settings->phase_limit_ms[phase];
+        }
+    }
+
+    /* Keep the current due tick unless the new interval brings the next probe forward. */
+    if (monitor->monitoring && target->interval_ms != old_interval_ms) {
+        uint64_t interval_ticks = MAX(1, target_interval_ms(monitor, target) / WHEEL_TICK_MS);
+        timer_wheel_cancel(&monitor->wheel, &target->timer);
+        schedule_target(monitor, target, MIN(target->next_due_tick, monitor->wheel.now + interval_ticks));
+    }
+}
+
+static void load_config_header(Monitor *monitor, const char *line) {
+    if (strncmp(line, "# auto_start=", 13) == 0) {
+        monitor->auto_start = atoi(line + 13) != 0;
+    } else if (strncmp(line, "# probe_backend=", 16) == 0) {
+        monitor_set_backend_url(monitor, line + 16);
+    } else if (strncmp(line, "# probe_rate=", 13) == 0 && monitor->probe_rate <= 0.0) {
+        monitor->probe_rate = g_ascii_strtod(line + 13, NULL);
+    } else if (strncmp(line, "# burst=", 8) == 0 && monitor->burst_count == 0) {
+        monitor->burst_count = CLAMP(atoi(line + 8), 1, MAX_BURST_COUNT);
+    } else if (strncmp(line, "# burst_spacing_ms=", 19) == 0 && monitor->burst_spacing_ms == 0) {
+        monitor->burst_spacing_ms = MAX(1, atoi(line + 19));
+    } else if (strncmp(line, "# adaptive_max_sec=", 19) == 0 && monitor->adaptive_max_ms == 0) {
+        monitor->adaptive_max_ms = MAX(0, atoi(line + 19)) * 1000;
+    }
+}
+
+typedef struct {
+    Monitor *monitor;
+    GHashTable *specs;
+} ConfigLoad;
+
+/* target_store_add() normalizes and dedups in one hash lookup; only a duplicate line is keyed again to
+   find the target its settings belong to. */
+static void on_load_line(char *line, void *user_data) {
+    ConfigLoad *load = user_data;
+    Monitor *monitor = load->monitor;
+    trim(line);
+    if (line[0] == '\0') {
+        return;
+    }
+    if (line[0] == '#') {
+        load_config_header(monitor, line);
+        return;
+    }
+
+    TargetSettings settings;
+    char *raw = parse_target_line(monitor, line, &settings);
+    if (raw == NULL) {
+        return;
+    }
+    Target *target = monitor_add_target(monitor, raw, false);
+    bool created = target != NULL;
+    char key[256];
+    if (target == NULL && target_key_for(raw, key, sizeof(key))) {
+        target = target_store_lookup_key(&monitor->targets, key);
+    }
+    if (target == NULL) {
+        return;
+    }
+    apply_target_settings(monitor, target, &settings, false);
+    if (load->specs != NULL) {
+        const TargetSpec *earlier = g_hash_table_lookup(load->specs, target->key);
+        TargetSpec *spec = g_new(TargetSpec, 1);
+        spec->raw = g_strdup(raw);
+        spec->settings = settings;
+        spec->owned = created || (earlier != NULL && earlier->owned);
+        g_hash_table_replace(load->specs, g_strdup(target->key), spec);
+    }
+}
+
+static bool load_config_file(Monitor *monitor, const char *path, GHashTable *specs) {
+    ConfigLoad load = {monitor, specs};
+    return config_read_lines(path, on_load_line, &load);
+}
+
+bool monitor_load_config(Monitor *monitor, const char *path) {
+    return load_config_file(monitor, path, NULL);
+}
+
+/* Reload only reads target lines; header settings still take effect at startup. */
+static void on_reload_line(char *line, void *user_data) {
+    ConfigLoad *load = user_data;
+    trim(line);
+    if (line[0] == '\0' || line[0] == '#') {
+        return;
+    }
+
+    TargetSettings settings;
+    char *raw = parse_target_line(load->monitor, line, &settings);
+    char key[256];
+    if (raw == NULL || !target_key_for(raw, key, sizeof(key))) {
+        if (raw != NULL) {
+            monitor_log(load->monitor, "Invalid target: %s", raw);
+        }
+        return;
+    }
+    TargetSpec *spec = g_new0(TargetSpec, 1);
+    spec->raw = g_strdup(raw);
+    spec->settings = settings;
+    g_hash_table_replace(load->specs, g_strdup(key), spec);
+}
+
+static void remove_target(Monitor *monitor, Target *target) {
+    timer_wheel_cancel(&monitor->wheel, &target->timer);
+    if (target->history_slot >= 0) {
+        g_hash_table_remove(monitor->history_slots, target->key);
+        history_file_release(&monitor->history, (uint32_t)target->history_slot);
+    }
+    target_store_remove(&monitor->targets, target->id);
+}
+
+/* Applies the difference between the watched file and what it held last time: targets that left the file
+   are removed, new ones added, and changed settings updated in place so the target keeps its history.
+   A target the file did not add itself stays when its line is removed. */
+static void on_config_changed(void *user_data) {
+    Monitor *monitor = user_data;
+    GHashTable *specs = new_spec_table();
+    ConfigLoad load = {monitor, specs};
+    if (!config_read_lines(monitor->config_path, on_reload_line, &load)) {
+        monitor_log(monitor, "Could not read %s; keeping the current targets.", monitor->config_path);
+        g_hash_table_destroy(specs);
+        return;
+    }
+
+    int removed = 0;
+    GHashTableIter iter;
+    gpointer key;
+    gpointer value;
+    g_hash_table_iter_init(&iter, monitor->config_specs);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        const TargetSpec *old = value;
+        Target *target = target_store_lookup_key(&monitor->targets, key);
+        if (old->owned && target != NULL && !g_hash_table_contains(specs, key)) {
+            remove_target(monitor, target);
+            removed++;
+        }
+    }
+
+    int added = 0;
+    int changed = 0;
+    g_hash_table_iter_init(&iter, specs);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        TargetSpec *spec = value;
+        const TargetSpec *old = g_hash_table_lookup(monitor->config_specs, key);
+        spec->owned = old != NULL && old->owned;
+        Target *target = target_store_lookup_key(&monitor->targets, key);
+        if (target == NULL) {
+            target = monitor_add_target(monitor, spec->raw, false);
+            if (target == NULL) {
+                continue;
+            }
+            spec->owned = true;
+            apply_target_settings(monitor, target, &spec->settings, true);
+            added++;
+        } else if (!target_settings_equal(target, &spec->settings)) {
+            apply_target_settings(monitor, target, &spec->settings, true);
+            changed++;
+        }
+    }
+
+    g_hash_table_destroy(monitor->config_specs);
+    monitor->config_specs = specs;
+    if (added > 0 || removed > 0 || changed > 0) {
+        prune_history(monitor);
+        monitor_log(monitor, "Reloaded %s: %d added, %d removed, %d changed.", monitor->config_path, added, removed,
+                    changed);
+        schedule_updated(monitor);
+    }
+}
+
+static void free_probe_job(ProbeJob *job) {
+    g_free(job->tasks);
+    g_free(job);
+}
+
+static gboolean on_updated_idle(gpointer user_data) {
+    Monitor *monitor = user_data;
+    monitor->updated_source_id = 0;
+    if (monitor->callbacks.updated != NULL) {
+        monitor->callbacks.updated(monitor->callbacks.user_data);
+    }
+    return G_SOURCE_REMOVE;
+}
+
+static void schedule_updated(Monitor *monitor) {
+    if (monitor->updated_source_id == 0) {
+        monitor->updated_source_id = g_idle_add(on_updated_idle, monitor);
+    }
+}
+
+static void push_alert(Monitor *monitor, const Target *target, AlertKind kind, const char *from) {
+    AlertEvent event = {
+        .kind = kind,
+        .target_id = target->id,
+        .timestamp = g_get_real_time() / 1e6,
+        .latency_ms = target->last_latency_ms,
+        .has_latency = target->has_latency,
+    };
+    snprintf(event.target, sizeof(event.target), "%s", target->display);
+    snprintf(event.host, sizeof(event.host), "%s", target->host);
+    snprintf(event.from, sizeof(event.from), "%s", from);
+    snprintf(event.to, sizeof(event.to), "%s", target->status);
+    alert_pipeline_push(monitor->alerts, &event);
+}
+
+/* The first status after start is not a transition. While a target is flapping its individual changes are
+   held back; sinks get one event when it starts flapping and one, with the settled status, when it stops. */
+static void note_status_change(Monitor *monitor, Target *target, const char *previous, int64_t now_ns) {
+    bool changed = strcmp(previous, "OFF") != 0 && strcmp(previous, target->status) != 0;
+    int flap = flap_state_update(&target->flap, now_ns, changed);
+    if (monitor->alerts == NULL) {
+        return;
+    }
+    if (flap > 0) {
+        push_alert(monitor, target, ALERT_FLAP_START, previous);
+    } else if (flap < 0) {
+        push_alert(monitor, target, ALERT_FLAP_END, previous);
+    } else if (changed && !target->flap.active) {
+        push_alert(monitor, target, ALERT_TRANSITION, previous);
+    }
+}
+
+static void relay_sample(Monitor *monitor, Target *target, bool success, double latency_ms, bool has_latency);
+
+/* Adaptive mode doubles a target's interval after every ADAPTIVE_STABLE_SAMPLES clean results in a row, up
+   to the ceiling. A failure, lost echo, latency anomaly, non-GREEN status or flapping drops it straight back
+   to the configured interval and probes again on the next tick, so a backed-off target costs at most one
+   long interval of detection time. */
+static void adapt_interval(Monitor *monitor, Target *target, bool success) {
+    if (monitor->adaptive_max_ms <= 0 || target->remote) {
+        return;
+    }
+    int base_ms = base_interval_ms(monitor, target);
+    bool unstable = !success || strcmp(target->status, "GREEN") != 0 || target->flap.active ||
+                    (target->has_loss && target->loss_pct > 0.0) || target_latency_anomaly(target);
+    if (unstable) {
+        target->stable_samples = 0;
+        if (target->adaptive_ms > base_ms) {
+            target->adaptive_ms = 0;
+            monitor->counters.adaptive_tightened++;
+            if (monitor->monitoring) {
+                timer_wheel_cancel(&monitor->wheel, &target->timer);
+                schedule_target(monitor, target, monitor->wheel.now + 1);
+            }
+        }
+        return;
+    }
+
+    if (++target->stable_samples < ADAPTIVE_STABLE_SAMPLES) {
+        return;
+    }
+    target->stable_samples = 0;
+    int current_ms = target_interval_ms(monitor, target);
+    if (current_ms < monitor->adaptive_max_ms) {
+        target->adaptive_ms = MIN(current_ms * 2, monitor->adaptive_max_ms);
+        monitor->counters.adaptive_backoffs++;
+    }
+}
+
+static void record_sample(Monitor *monitor, Target *target, time_t timestamp, int64_t mono_ns, bool success,
+                          double latency_ms, bool has_latency) {
+    char previous[sizeof(target->status)];
+    memcpy(previous, target->status, sizeof(previous));
+    add_history_at(target, timestamp, mono_ns, success, latency_ms, has_latency);
+    compute_status(target);
+    note_status_change(monitor, target, previous, mono_ns);
+    adapt_interval(monitor, target, success);
+    if (target->history_slot >= 0) {
+        history_file_append(&monitor->history, (uint32_t)target->history_slot, (int64_t)timestamp, success,
+                            latency_ms, has_latency);
+    }
+    if (monitor->relay_sender != NULL && !target->remote) {
+        relay_sample(monitor, target, success, latency_ms, has_latency);
+    }
+    if (monitor->callbacks.sample != NULL) {
+        monitor->callbacks.sample(target, monitor->callbacks.user_data);
+    }
+}
+
+static void record_result(Monitor *monitor, const ProbeTask *task) {
+    if (task->dispatched_ns > 0) {
+        monitor->diag.in_flight[task->kind]--;
+        duration_histogram_add(&monitor->diag.completion[task->kind], monotonic_ns() - task->dispatched_ns);
+    }
+    Target *target = target_store_lookup_id(&monitor->targets, task->target_id);
+    if (target == NULL) {
+        return;
+    }
+    target->in_flight = false;
+    monitor->counters.probes++;
+    target->last_failure = task->success ? NULL : task->failure;
+    target->loss_pct = task->loss_pct;
+    target->has_loss = task->has_loss;
+    target->reported_jitter_ms = task->reported_jitter_ms;
+    target->has_reported_jitter = task->has_reported_jitter;
+    target->samples = task->samples;
+    target->latency_min_ms = task->latency_min_ms;
+    target->latency_max_ms = task->latency_max_ms;
+    target->has_latency_range = task->has_latency_range;
+    target->has_phases = task->has_phases;
+    if (task->has_phases) {
+        memcpy(target->phase_ms, task->phase_ms, sizeof(target->phase_ms));
+    }
+    if (!task->success) {
+        monitor->counters.probe_failures++;
+    }
+    if (task->probe == TARGET_PROBE_TCP && target->last_failure != NULL) {
+        if (strcmp(target->last_failure, "refused") == 0) {
+            monitor->counters.tcp_refused++;
+        } else if (strcmp(target->last_failure, "timeout") == 0) {
+            monitor->counters.tcp_timeouts++;
+        }
+    }
+    record_sample(monitor, target, time(NULL), task->finished_ns, task->success, task->latency_ms, task->has_latency);
+}
+
+/* Agents announce a target the first time they report it and again every RELAY_ANNOUNCE_SEC, so an
+   aggregator that starts later still learns every name. */
+static void relay_sample(Monitor *monitor, Target *target, bool success, double latency_ms, bool has_latency) {
+    if (!target->relay_announced) {
+        relay_sender_announce(monitor->relay_sender, target->id, target->display);
+        target->relay_announced = true;
+    }
+    RelayResult result = {
+        .target_id = target->id,
+        .timestamp_ms = g_get_real_time() / 1000,
+        .ok = success,
+        .has_latency = has_latency,
+        .latency_ms = latency_ms,
+    };
+    relay_sender_add(monitor->relay_sender, &result);
+}
+
+static gboolean flush_finished_jobs(gpointer user_data) {
+    Monitor *monitor = user_data;
+
+    g_mutex_lock(&monitor->results_lock);
+    GPtrArray *jobs = monitor->finished_jobs;
+    monitor->finished_jobs = g_ptr_array_new();
+    monitor->flush_source_id = 0;
+    g_mutex_unlock(&monitor->results_lock);
+
+    for (guint i = 0; i < jobs->len; ++i) {
+        ProbeJob *job = g_ptr_array_index(jobs, i);
+        monitor->counters.spawn_errors += (guint64)job->spawn_errors;
+        monitor->counters.socket_errors += (guint64)job->socket_errors;
+        for (int j = 0; j < job->task_count; ++j) {
+            const ProbeTask *task = &job->tasks[j];
+            record_result(monitor, task);
+        }
+        free_probe_job(job);
+        monitor->jobs_in_flight--;
+    }
+    g_ptr_array_free(jobs, TRUE);
+
+    schedule_updated(monitor);
+    return G_SOURCE_REMOVE;
+}
+
+static void finish_probe_job(Monitor *monitor, ProbeJob *job) {
+    g_mutex_lock(&monitor->results_lock);
+    g_ptr_array_add(monitor->finished_jobs, job);
+    if (monitor->flush_source_id == 0) {
+        monitor->flush_source_id = g_idle_add(flush_finished_jobs, monitor);
+    }
+    g_mutex_unlock(&monitor->results_lock);
+}
+
+static const char *probe_address(const ProbeTask *task) {
+    return task->address[0] != '\0' ? task->address : task->host;
+}
+
+static int job_timeout_ms(const ProbeJob *job) {
+    int timeout_ms = 0;
+    for (int i = 0; i < job->task_count; ++i) {
+        timeout_ms = MAX(timeout_ms, job->tasks[i].timeout_ms);
+    }
+    return timeout_ms;
+}
+
+/* A reply that arrives after the target's own timeout counts as a drop. */
+static void apply_task_timeout(ProbeTask *task) {
+    if (task->success && task->has_latency && task->latency_ms > task->timeout_ms) {
+        task->success = false;
+        task->has_latency = false;
+        task->failure = "timeout";
+    }
+}
+
+static void probe_worker(gpointer data, gpointer user_data) {
+    ProbeJob *job = data;
+    Monitor *monitor = user_data;
+
+    /* Jobs still queued at shutdown are handed back unprobed, so monitor_shutdown() can free them. */
+    if (g_atomic_int_get(&monitor->shutting_down)) {
+        finish_probe_job(monitor, job);
+        return;
+    }
+
+    if (job->kind == PROBE_JOB_TCP_BATCH) {
+        TcpProbe *probes = g_new0(TcpProbe, job->task_count);
+        for (int i = 0; i < job->task_count; ++i) {
+            probes[i].host = probe_address(&job->tasks[i]);
+            probes[i].port = job->tasks[i].port;
+        }
+        tcp_probe_run(probes, job->task_count, job_timeout_ms(job));
+        for (int i = 0; i < job->task_count; ++i) {
+            ProbeTask *task = &job->tasks[i];
+            task->success = probes[i].success;
+            task->latency_ms = probes[i].latency_ms;
+            task->has_latency = probes[i].has_latency;
+            task->failure = probes[i].success ? NULL : tcp_connect_result_name(probes[i].result);
+            job->socket_errors += probes[i].result == TCP_CONNECT_ERROR;
+            task->finished_ns = monotonic_ns();
+            apply_task_timeout(task);
+        }
+        g_free(probes);
+    } else if (job->kind == PROBE_JOB_NATIVE_BATCH) {
+        IcmpProbe *probes = g_new0(IcmpProbe, job->task_count);
+        for (int i = 0; i < job->task_count; ++i) {
+            probes[i].host = probe_address(&job->tasks[i]);
+        }
+        icmp_engine_run(&monitor->icmp, probes, job->task_count, job->burst, job->burst_spacing_ms,
+                        job_timeout_ms(job));
+        for (int i = 0; i < job->task_count; ++i) {
+            apply_icmp_probe(&job->tasks[i], &probes[i], job->burst);
+            job->socket_errors += probes[i].send_errors;
+            apply_task_timeout(&job->tasks[i]);
+            job->tasks[i].finished_ns = monotonic_ns();
+            if (probes[i].has_latency) {
+                const struct timespec *sent = &probes[i].sent_at;
+                job->tasks[i].finished_ns = (int64_t)sent->tv_sec * 1000000000 + sent->tv_nsec +
+                                            (int64_t)(probes[i].latency_ms * 1000000.0);
+            }
+        }
+        g_free(probes);
+    } else {
+        for (int i = 0; i < job->task_count; ++i) {
+            ProbeTask *task = &job->tasks[i];
+            IcmpProbe probe;
+            memset(&probe, 0, sizeof(probe));
+            if (!run_ping(probe_address(task), task->timeout_ms, job->burst, job->burst_spacing_ms, &probe)) {
+                job->spawn_errors++;
+            }
+            apply_icmp_probe(task, &probe, job->burst);
+            task->finished_ns = monotonic_ns();
+            apply_task_timeout(task);
+        }
+    }
+
+    finish_probe_job(monitor, job);
+}
+
+static void on_backend_response(const HttpResponse *response, gpointer user_data) {
+    BackendRequest *request = user_data;
+    Monitor *monitor = request->monitor;
+    char batch_flag[16];
+    if (http_response_header(response, "X-NetPulse-Batch", batch_flag, sizeof(batch_flag)) &&
+        strcmp(batch_flag, "1") == 0 && strcmp(monitor->batch_backend_url, request->job->backend_url) != 0) {
+        snprintf(monitor->batch_backend_url, sizeof(monitor->batch_backend_url), "%s", request->job->backend_url);
+        monitor_log(monitor, "Backend advertises batch probing; sending one request per tick.");
+    }
+
+    ProbeTask *task = &request->job->tasks[0];
+    task->has_latency = false;
+    ProbeResult result;
+    const char *body_end = response->body + response->body_len;
+    if (response->ok && probe_result_parse(response->body, body_end, &result) != NULL) {
+        apply_probe_result(task, &result);
+    } else {
+        task->success = response->ok;
+    }
+    task->finished_ns = monotonic_ns();
+    finish_probe_job(request->monitor, request->job);
+    g_free(request);
+}
+
+static const char *const SLOW_PHASE_FAILURES[HTTP_PHASE_COUNT] = {"slow_dns", "slow_connect", "slow_tls",
+                                                                  "slow_ttfb"};
+
+/* A response over any configured phase limit counts as a drop, so the health light reflects slow phases. */
+static void on_http_probe_response(const HttpResponse *response, gpointer user_data) {
+    BackendRequest *request = user_data;
+    ProbeTask *task = &request->job->tasks[0];
+    task->success = response->ok;
+    task->failure = response->failure;
+    task->latency_ms = response->total_ms;
+    task->has_latency = response->ok;
+    task->has_phases = true;
+    memcpy(task->phase_ms, response->timings.phase_ms, sizeof(task->phase_ms));
+    for (int phase = 0; phase < HTTP_PHASE_COUNT && task->success; ++phase) {
+        if (task->phase_limit_ms[phase] > 0 && task->phase_ms[phase] > task->phase_limit_ms[phase]) {
+            task->success = false;
+            task->failure = SLOW_PHASE_FAILURES[phase];
+        }
+    }
+    task->finished_ns = monotonic_ns();
+    apply_task_timeout(task);
+    finish_probe_job(request->monitor, request->job);
+    g_free(request);
+}
+
+static void dispatch_http_job(Monitor *monitor, ProbeJob *job) {
+    BackendRequest *request = g_new0(BackendRequest, 1);
+    request->monitor = monitor;
+    request->job = job;
+    monitor->jobs_in_flight++;
+    http_client_probe(monitor->http, job->tasks[0].display, job->tasks[0].timeout_ms, monitor->http_reuse,
+                      on_http_probe_response, request);
+}
+
+static void dispatch_backend_job(Monitor *monitor, ProbeJob *job) {
+    BackendRequest *request = g_new0(BackendRequest, 1);
+    request->monitor = monitor;
+    request->job = job;
+    monitor->jobs_in_flight++;
+
+    gchar *url = build_backend_url(job->backend_url, job->tasks[0].display);
+    http_client_get(monitor->http, url, job->tasks[0].timeout_ms, on_backend_response, request);
+    g_free(url);
+}
+
+static ProbeJob *new_probe_job(ProbeJobKind kind, const char *backend_url, int task_count) {
+    ProbeJob *job = g_new0(ProbeJob, 1);
+    job->kind = kind;
+    if (backend_url != NULL) {
+        snprintf(job->backend_url, sizeof(job->backend_url), "%s", backend_url);
+    }
+    job->tasks = g_new0(ProbeTask, task_count);
+    job->task_count = task_count;
+    return job;
+}
+
+static void set_job_burst(const Monitor *monitor, ProbeJob *job) {
+    job->burst = MAX(1, monitor->burst_count);
+    job->burst_spacing_ms = monitor->burst_spacing_ms > 0 ? monitor->burst_spacing_ms : DEFAULT_BURST_SPACING_MS;
+}
+
+/* Every dispatched task is counted in flight until record_result() sees it, and the time from its due tick
+   to now goes into the dispatch histogram of its kind. */
+static void fill_probe_task(Monitor *monitor, ProbeTask *task, const Target *target, int default_timeout_ms,
+                            ProbeKind kind) {
+    task->kind = kind;
+    task->due_ns = target->due_ns;
+    task->dispatched_ns = monotonic_ns();
+    monitor->diag.in_flight[kind]++;
+    if (target->due_ns > 0) {
+        duration_histogram_add(&monitor->diag.dispatch[kind], task->dispatched_ns - target->due_ns);
+    }
+    task->target_id = target->id;
+    task->probe = target->probe;
+    task->port = target->port;
+    memcpy(task->phase_limit_ms, target->phase_limit_ms, sizeof(task->phase_limit_ms));
+    task->timeout_ms = target->timeout_ms > 0 ? target->timeout_ms : default_timeout_ms;
+    snprintf(task->host, sizeof(task->host), "%s", target->host);
+    snprintf(task->address, sizeof(task->address), "%s", target->address);
+    snprintf(task->display, sizeof(task->display), "%s", target->display);
+}
+
+static void dispatch_probe_job(Monitor *monitor, ProbeJob *job) {
+    monitor->jobs_in_flight++;
+    g_thread_pool_push(monitor->probe_pool, job, NULL);
+}
+
+static void on_batch_result(const ProbeResult *result, void *user_data) {
+    BackendBatch *batch = user_data;
+    ProbeTask *task = result->has_target ? g_hash_table_lookup(batch->pending, result->target) : NULL;
+    if (task == NULL) {
+        return;
+    }
+    g_hash_table_remove(batch->pending, result->target);
+    apply_probe_result(task, result);
+    task->finished_ns = monotonic_ns();
+    record_result(batch->monitor, task);
+}
+
+/* Objects are applied as soon as they are complete, whether the backend streams NDJSON or sends one array,
+   and only the unfinished tail of the buffer is kept for the next chunk. */
+static void apply_batch_buffer(BackendBatch *batch) {
+    size_t consumed = probe_results_scan(batch->buffer->str, batch->buffer->len, on_batch_result, batch);
+    if (consumed > 0) {
+        g_string_erase(batch->buffer, 0, (gssize)consumed);
+        schedule_updated(batch->monitor);
+    }
+}
+
+static void on_batch_chunk(const char *data, size_t len, gpointer user_data) {
+    BackendBatch *batch = user_data;
+    g_string_append_len(batch->buffer, data, (gssize)len);
+    apply_batch_buffer(batch);
+}
+
+static void on_batch_response(const HttpResponse *response, gpointer user_data) {
+    BackendBatch *batch = user_data;
+    Monitor *monitor = batch->monitor;
+
+    /* A batch cut short by shutdown is dropped like any other unfinished job, not recorded as failures. */
+    bool cancelled = g_atomic_int_get(&monitor->shutting_down) ||
+                     (response->failure != NULL && strcmp(response->failure, "cancelled") == 0);
+    if (response->ok && !cancelled) {
+        apply_batch_buffer(batch);
+    }
+
+    GHashTableIter iter;
+    gpointer key;
+    gpointer value;
+    bool rejected = !cancelled && !response->ok && response->status >= 400;
+    if (rejected) {
+        monitor_log(monitor, "Backend rejected batch probe (HTTP %ld); falling back to per-target requests.",
+                    response->status);
+        monitor->batch_backend_url[0] = '\0';
+    }
+
+    g_hash_table_iter_init(&iter, batch->pending);
+    while (!cancelled && g_hash_table_iter_next(&iter, &key, &value)) {
+        ProbeTask *task = value;
+        if (rejected) {
+            ProbeJob *retry = new_probe_job(PROBE_JOB_BACKEND, batch->job->backend_url, 1);
+            retry->tasks[0] = *task;
+            dispatch_backend_job(monitor, retry);
+            continue;
+        }
+        task->success = false;
+        task->has_latency = false;
+        /* A complete answer that left the target out is the backend's failure, not the transport's. */
+        task->failure = response->failure != NULL ? response->failure : "backend";
+        task->finished_ns = monotonic_ns();
+        record_result(monitor, task);
+    }
+
+    g_hash_table_destroy(batch->pending);
+    g_string_free(batch->buffer, TRUE);
+    free_probe_job(batch->job);
+    g_free(batch);
+    monitor->jobs_in_flight--;
+    schedule_updated(monitor);
+}
+
+static void dispatch_backend_batch(Monitor *monitor, ProbeJob *job) {
+    BackendBatch *batch = g_new0(BackendBatch, 1);
+    batch->monitor = monitor;
+    batch->job = job;
+    batch->pending = g_hash_table_new(g_str_hash, g_str_equal);
+    batch->buffer = g_string_sized_new(4096);
+
+    GString *body = g_string_sized_new(64 + (gsize)job->task_count * 32);
+    g_string_append(body, "{\"targets\":[");
+    for (int i = 0; i < job->task_count; ++i) {
+        ProbeTask *task = &job->tasks[i];
+        if (g_hash_table_contains(batch->pending, task->display)) {
+            continue;
+        }
+        if (g_hash_table_size(batch->pending) > 0) {
+            g_string_append_c(body, ',');
+        }
+        g_hash_table_insert(batch->pending, task->display, task);
+        append_json_string(body, task->display);
+    }
+    g_string_append(body, "]}");
+
+    monitor->jobs_in_flight++;
+    http_client_post(monitor->http, job->backend_url, "application/json", body->str, body->len,
+                     job_timeout_ms(job), on_batch_chunk, on_batch_response, batch);
+    g_string_free(body, TRUE);
+}
+
+static void on_target_due(TimerEntry *entry, void *user_data) {
+    Monitor *monitor = user_data;
+    Target *target = entry->data;
+    int64_t due_ns = (int64_t)entry->expires * WHEEL_TICK_MS * 1000000;
+    uint64_t interval_ticks = MAX(1, target_interval_ms(monitor, target) / WHEEL_TICK_MS);
+    schedule_target(monitor, target, target->next_due_tick + interval_ticks);
+
+    if (target->in_flight || target->queued) {
+        monitor->counters.probes_skipped++;
+        return;
+    }
+    target->queued = true;
+    target->due_ns = due_ns;
+    target->queued_denials = monitor->budget_denials;
+    g_queue_push_tail(monitor->ready, GUINT_TO_POINTER(target->id));
+}
+
+/* TCP targets are always connected to locally, in one batch per tick, whatever the probe backend is. */
+static void dispatch_tcp(Monitor *monitor, GPtrArray *due) {
+    int tcp_count = 0;
+    for (guint i = 0; i < due->len; ++i) {
+        const Target *target = g_ptr_array_index(due, i);
+        tcp_count += target->probe == TARGET_PROBE_TCP;
+    }
+    if (tcp_count == 0) {
+        return;
+    }
+
+    ProbeJob *job = new_probe_job(PROBE_JOB_TCP_BATCH, NULL, tcp_count);
+    int next = 0;
+    for (guint i = 0; i < due->len;) {
+        const Target *target = g_ptr_array_index(due, i);
+        if (target->probe == TARGET_PROBE_TCP) {
+            fill_probe_task(monitor, &job->tasks[next++], target, TCP_TIMEOUT_SEC * 1000, PROBE_KIND_TCP);
+            g_ptr_array_remove_index_fast(due, i);
+        } else {
+            ++i;
+        }
+    }
+    dispatch_probe_job(monitor, job);
+}
+
+/* Without a probe backend, URL targets are fetched directly, one pooled curl transfer each. */
+static void dispatch_http(Monitor *monitor, GPtrArray *due) {
+    if (is_valid_probe_url(monitor->probe_backend_url)) {
+        return;
+    }
+    for (guint i = 0; i < due->len;) {
+        const Target *target = g_ptr_array_index(due, i);
+        if (target->probe != TARGET_PROBE_HTTP) {
+            ++i;
+            continue;
+        }
+        ProbeJob *job = new_probe_job(PROBE_JOB_HTTP, NULL, 1);
+        fill_probe_task(monitor, &job->tasks[0], target, PROBE_TIMEOUT_SEC * 1000, PROBE_KIND_HTTP);
+        dispatch_http_job(monitor, job);
+        g_ptr_array_remove_index_fast(due, i);
+    }
+}
+
+static void dispatch_due(Monitor *monitor, GPtrArray *due) {
+    dispatch_tcp(monitor, due);
+    dispatch_http(monitor, due);
+    if (due->len == 0) {
+        return;
+    }
+
+    int default_timeout_ms = PING_TIMEOUT_SEC * 1000;
+    int count = (int)due->len;
+    const char *probe_url = monitor->probe_backend_url;
+    bool use_backend = is_valid_probe_url(probe_url);
+    if (use_backend) {
+        default_timeout_ms = PROBE_TIMEOUT_SEC * 1000;
+    }
+
+    if (!use_backend && monitor->engine == PROBE_ENGINE_NATIVE) {
+        ProbeJob *job = new_probe_job(PROBE_JOB_NATIVE_BATCH, NULL, count);
+        set_job_burst(monitor, job);
+        for (int i = 0; i < count; ++i) {
+            fill_probe_task(monitor, &job->tasks[i], g_ptr_array_index(due, i), default_timeout_ms, PROBE_KIND_ICMP);
+        }
+        dispatch_probe_job(monitor, job);
+        return;
+    }
+
+    if (use_backend && strcmp(monitor->batch_backend_url, probe_url) == 0) {
+        ProbeJob *job = new_probe_job(PROBE_JOB_BACKEND_BATCH, probe_url, count);
+        for (int i = 0; i < count; ++i) {
+            fill_probe_task(monitor, &job->tasks[i], g_ptr_array_index(due, i), default_timeout_ms, PROBE_KIND_BACKEND);
+        }
+        dispatch_backend_batch(monitor, job);
+        return;
+    }
+
+    for (int i = 0; i < count; ++i) {
+        if (use_backend) {
+            ProbeJob *job = new_probe_job(PROBE_JOB_BACKEND, probe_url, 1);
+            fill_probe_task(monitor, &job->tasks[0], g_ptr_array_index(due, i), default_timeout_ms, PROBE_KIND_BACKEND);
+            dispatch_backend_job(monitor, job);
+        } else {
+            ProbeJob *job = new_probe_job(PROBE_JOB_PING, NULL, 1);
+            set_job_burst(monitor, job);
+            fill_probe_task(monitor, &job->tasks[0], g_ptr_array_index(due, i), default_timeout_ms, PROBE_KIND_PING);
+            dispatch_probe_job(monitor, job);
+        }
+    }
+}
+
+/* Local probes go to the cached address, so a slow resolver never shows up as probe latency. Hostnames
+   still being looked up wait in the resolving queue; a failed lookup is recorded as a failed probe. */
+static DnsState resolve_target(Monitor *monitor, Target *target) {
+    target->address[0] = '\0';
+    bool local = target->probe == TARGET_PROBE_TCP || !is_valid_probe_url(monitor->probe_backend_url);
+    if (monitor->dns == NULL || !local || target->probe == TARGET_PROBE_HTTP ||
+        g_hostname_is_ip_address(target->host)) {
+        return DNS_RESOLVED;
+    }
+
+    DnsAnswer answer;
+    DnsState state = dns_cache_lookup(monitor->dns, target->host, &answer);
+    if (state == DNS_PENDING) {
+        return state;
+    }
+    target->resolve_ms = answer.resolve_ms;
+    target->has_resolve = true;
+    if (state == DNS_RESOLVED) {
+        snprintf(target->address, sizeof(target->address), "%s", answer.address);
+        target->resolve_failed = false;
+    } else {
+        if (!target->resolve_failed) {
+            monitor_log(monitor, "Could not resolve %s: %s", target->host, answer.error);
+        }
+        target->resolve_failed = true;
+    }
+    return state;
+}
+
+static void record_resolve_failure(Monitor *monitor, Target *target) {
+    ProbeTask task;
+    memset(&task, 0, sizeof(task));
+    task.target_id = target->id;
+    task.failure = "dns";
+    task.finished_ns = monotonic_ns();
+    record_result(monitor, &task);
+}
+
+/* A probe that leaves the ready queue after the budget ran out at least once while it waited counts as
+   deferred once, however many ticks it was held back. */
+static void take_ready_target(Monitor *monitor, Target *target) {
+    g_queue_pop_head(monitor->ready);
+    target->queued = false;
+    if (target->queued_denials != monitor->budget_denials) {
+        monitor->counters.probes_deferred++;
+    }
+}
+
+/* Runs every wheel tick: targets that came due are queued, then as many queued targets as the
+   probe rate budget allows are sent together as one batch. */
+static gboolean monitor_tick(gpointer user_data) {
+    Monitor *monitor = user_data;
+    if (!monitor->monitoring) {
+        return G_SOURCE_REMOVE;
+    }
+
+    int64_t now_ns = monotonic_ns();
+    uint64_t tick = current_tick();
+    /* A tick that fires well after its period, or has to catch the wheel up over several ticks, means the
+       main loop was blocked. */
+    if (monitor->diag.last_tick_ns > 0 && now_ns - monitor->diag.last_tick_ns > (int64_t)WHEEL_TICK_MS * 1500000) {
+        monitor->counters.ticks_late++;
+    }
+    if (tick > monitor->wheel.now + 1) {
+        monitor->counters.ticks_missed += tick - monitor->wheel.now - 1;
+    }
+    monitor->diag.last_tick_ns = now_ns;
+    timer_wheel_advance(&monitor->wheel, tick, on_target_due, monitor);
+    if (monitor->dns != NULL) {
+        dns_cache_poll(monitor->dns);
+        while (!g_queue_is_empty(monitor->resolving)) {
+            g_queue_push_tail(monitor->ready, g_queue_pop_head(monitor->resolving));
+        }
+    }
+
+    g_ptr_array_set_size(monitor->due, 0);
+    while (!g_queue_is_empty(monitor->ready)) {
+        unsigned int id = GPOINTER_TO_UINT(g_queue_peek_head(monitor->ready));
+        Target *target = target_store_lookup_id(&monitor->targets, id);
+        if (target == NULL) {
+            g_queue_pop_head(monitor->ready);
+            continue;
+        }
+        DnsState dns = resolve_target(monitor, target);
+        if (dns == DNS_PENDING) {
+            g_queue_push_tail(monitor->resolving, g_queue_pop_head(monitor->ready));
+            continue;
+        }
+        if (dns == DNS_FAILED) {
+            take_ready_target(monitor, target);
+            record_resolve_failure(monitor, target);
+            continue;
+        }
+        if (!token_bucket_take(&monitor->budget, now_ns)) {
+            monitor->budget_denials++;
+            break;
+        }
+        take_ready_target(monitor, target);
+        target->in_flight = true;
+        g_ptr_array_add(monitor->due, target);
+    }
+
+    if (monitor->due->len > 0) {
+        monitor->counters.ticks++;
+        dispatch_due(monitor, monitor->due);
+    }
+    int64_t duration_ns = monotonic_ns() - now_ns;
+    duration_histogram_add(&monitor->diag.tick, duration_ns);
+    if (duration_ns > (int64_t)WHEEL_TICK_MS * 1000000) {
+        monitor->counters.ticks_overrun++;
+    }
+    if (monitor->callbacks.tick != NULL) {
+        monitor->callbacks.tick(duration_ns, monitor->callbacks.user_data);
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+static void start_target(Monitor *monitor, Target *target, size_t index, size_t count) {
+    if (target->remote) {
+        return;
+    }
+    /* Spread first probes evenly over each target's interval instead of firing all at once. */
+    uint64_t interval_ticks = MAX(1, target_interval_ms(monitor, target) / WHEEL_TICK_MS);
+    uint64_t offset = interval_ticks * index / MAX(count, 1);
+    schedule_target(monitor, target, monitor->wheel.now + offset);
+    resolve_target(monitor, target);
+}
+
+void monitor_start(Monitor *monitor) {
+    if (monitor->monitoring) {
+        return;
+    }
+    size_t count = target_store_count(&monitor->targets);
+    if (count == 0) {
+        monitor_log(monitor, "Add at least one target before starting monitor.");
+        return;
+    }
+
+    monitor->monitoring = true;
+    monitor->diag.last_tick_ns = 0;
+    timer_wheel_init(&monitor->wheel, current_tick());
+    double burst = MAX(1.0, monitor->probe_rate * WHEEL_TICK_MS / 1000.0);
+    token_bucket_init(&monitor->budget, monitor->probe_rate, burst, monotonic_ns());
+    for (size_t i = 0; i < count; ++i) {
+        start_target(monitor, target_store_at(&monitor->targets, i), i, count);
+    }
+    monitor->timer_id = g_timeout_add(WHEEL_TICK_MS, monitor_tick, monitor);
+    monitor_tick(monitor);
+
+    const char *probe_url = monitor->probe_backend_url;
+    if (is_valid_probe_url(probe_url)) {
+        monitor_log(monitor, "Monitoring started via backend probe (%s), interval %d sec.", probe_url,
+                    monitor->interval_sec);
+    } else if (probe_url != NULL && probe_url[0] != '\0') {
+        monitor_log(monitor, "Monitoring started with ICMP ping; probe backend must begin with http:// or https://.");
+    } else if (monitor->engine == PROBE_ENGINE_NATIVE) {
+        monitor_log(monitor, "Monitoring started with native ICMP (%s), interval %d sec.",
+                    icmp_engine_describe(&monitor->icmp), monitor->interval_sec);
+    } else {
+        monitor_log(monitor, "Monitoring started (%d second interval).", monitor->interval_sec);
+    }
+    if (monitor->probe_rate > 0.0) {
+        monitor_log(monitor, "Probe rate limited to %.0f probes/sec.", monitor->probe_rate);
+    }
+    if (monitor->burst_count > 1) {
+        ProbeJob burst;
+        set_job_burst(monitor, &burst);
+        monitor_log(monitor, "Sending %d echoes per ICMP probe, %d ms apart.", burst.burst, burst.burst_spacing_ms);
+    }
+    if (monitor->adaptive_max_ms > 0) {
+        monitor_log(monitor, "Adaptive intervals: stable targets back off up to %d sec.",
+                    monitor->adaptive_max_ms / 1000);
+    }
+}
+
+void monitor_stop(Monitor *monitor) {
+    if (!monitor->monitoring) {
+        return;
+    }
+
+    monitor->monitoring = false;
+    if (monitor->timer_id != 0) {
+        g_source_remove(monitor->timer_id);
+        monitor->timer_id = 0;
+    }
+    for (size_t i = 0; i < target_store_count(&monitor->targets); ++i) {
+        Target *target = target_store_at(&monitor->targets, i);
+        timer_wheel_cancel(&monitor->wheel, &target->timer);
+        target->queued = false;
+    }
+    g_queue_clear(monitor->ready);
+    g_queue_clear(monitor->resolving);
+    monitor_log(monitor, "Monitoring stopped.");
+}
+
+static void append_quantile_ms(GString *out, const DurationHistogram *histogram, double quantile) {
+    double value = duration_histogram_quantile_ms(histogram, quantile);
+    if (value < 0.0) {
+        g_string_append(out, "-");
+    } else {
+        g_string_append_printf(out, "%.2f", value);
+    }
+}
+
+/* Summarizes the monitor's own health for the diagnostics panel: one line for the scheduler, then one per
+   probe kind that has been used. Quantiles are bucket upper bounds, so they err on the slow side. */
+void monitor_describe_diagnostics(const Monitor *monitor, GString *out) {
+    const MonitorDiagnostics *diag = &monitor->diag;
+    const MonitorCounters *counters = &monitor->counters;
+    g_string_append(out, "Tick p50/p99/max ");
+    append_quantile_ms(out, &diag->tick, 0.50);
+    g_string_append_c(out, '/');
+    append_quantile_ms(out, &diag->tick, 0.99);
+    g_string_append_printf(out, "/%.2f ms", (double)diag->tick.max_us / 1000.0);
+    g_string_append_printf(out,
+                           " | Overruns %" G_GUINT64_FORMAT " | Late %" G_GUINT64_FORMAT " | Missed %" G_GUINT64_FORMAT
+                           " | Skipped %" G_GUINT64_FORMAT " | Queued %u | Errors spawn %" G_GUINT64_FORMAT
+                           " socket %" G_GUINT64_FORMAT,
+                           counters->ticks_overrun, counters->ticks_late, counters->ticks_missed,
+                           counters->probes_skipped, monitor->ready != NULL ? g_queue_get_length(monitor->ready) : 0,
+                           counters->spawn_errors, counters->socket_errors);
+
+    for (int kind = 0; kind < PROBE_KIND_COUNT; ++kind) {
+        if (diag->dispatch[kind].total == 0 && diag->in_flight[kind] == 0) {
+            continue;
+        }
+        g_string_append_printf(out, "\n%s: %d in flight | dispatch p50/p99 ", probe_kind_name((ProbeKind)kind),
+                               diag->in_flight[kind]);
+        append_quantile_ms(out, &diag->dispatch[kind], 0.50);
+        g_string_append_c(out, '/');
+        append_quantile_ms(out, &diag->dispatch[kind], 0.99);
+        g_string_append(out, " ms | completion p50/p99 ");
+        append_quantile_ms(out, &diag->completion[kind], 0.50);
+        g_string_append_c(out, '/');
+        append_quantile_ms(out, &diag->completion[kind], 0.99);
+        g_string_append(out, " ms");
+    }
+}
+
+/* Ids of the per-vantage and combined targets an agent's target id feeds, in one vantage's table. */
+typedef struct {
+    unsigned int vantage_id;
+    unsigned int combined_id;
+} RemoteTarget;
+
+static Target *add_remote_target(Monitor *monitor, const char *name, const char *vantage, bool *added) {
+    TargetAddResult result;
+    Target *target = target_store_add_remote(&monitor->targets, name, vantage, &result);
+    if (target != NULL && result == TARGET_ADD_OK) {
+        target->remote = true;
+        attach_history(monitor, target);
+        *added = true;
+    }
+    return target;
+}
+
+static void on_relay_announce(const char *vantage, uint32_t target_id, const char *name, gpointer user_data) {
+    Monitor *monitor = user_data;
+    GHashTable *targets = g_hash_table_lookup(monitor->vantages, vantage);
+    if (targets == NULL) {
+        targets = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+        g_hash_table_insert(monitor->vantages, g_strdup(vantage), targets);
+        monitor_log(monitor, "Receiving results from vantage point %s", vantage);
+    }
+
+    bool added = false;
+    Target *per_vantage = add_remote_target(monitor, name, vantage, &added);
+    Target *combined = add_remote_target(monitor, name, NULL, &added);
+    if (per_vantage == NULL || combined == NULL) {
+        return;
+    }
+    RemoteTarget *remote = g_hash_table_lookup(targets, GUINT_TO_POINTER(target_id));
+    if (remote == NULL) {
+        remote = g_new(RemoteTarget, 1);
+        g_hash_table_insert(targets, GUINT_TO_POINTER(target_id), remote);
+    }
+    remote->vantage_id = per_vantage->id;
+    remote->combined_id = combined->id;
+    if (added) {
+        schedule_updated(monitor);
+    }
+}
+
+/* Each result is recorded twice, into the target's history for its vantage point and into the combined
+   target, which so shows the status as seen from everywhere. Results for ids that have not been announced
+   yet are counted and dropped. */
+static void on_relay_results(const char *vantage, const RelayResult *results, size_t count, gpointer user_data) {
+    Monitor *monitor = user_data;
+    GHashTable *targets = g_hash_table_lookup(monitor->vantages, vantage);
+    if (targets == NULL) {
+        monitor->counters.relay_unknown += count;
+        return;
+    }
+
+    time_t now = time(NULL);
+    int64_t now_ns = monotonic_ns();
+    for (size_t i = 0; i < count; ++i) {
+        const RelayResult *result = &results[i];
+        RemoteTarget *remote = g_hash_table_lookup(targets, GUINT_TO_POINTER(result->target_id));
+        if (remote == NULL) {
+            monitor->counters.relay_unknown++;
+            continue;
+        }
+        time_t timestamp = MIN((time_t)(result->timestamp_ms / 1000), now);
+        unsigned int ids[] = {remote->vantage_id, remote->combined_id};
+        for (size_t j = 0; j < G_N_ELEMENTS(ids); ++j) {
+            Target *target = target_store_lookup_id(&monitor->targets, ids[j]);
+            if (target != NULL) {
+                target->last_failure = result->ok ? NULL : "remote";
+                record_sample(monitor, target, timestamp, now_ns, result->ok, result->latency_ms,
+                              result->has_latency);
+            }
+        }
+    }
+    schedule_updated(monitor);
+}
+
+static gboolean on_relay_flush(gpointer user_data) {
+    Monitor *monitor = user_data;
+    relay_sender_flush(monitor->relay_sender);
+    return G_SOURCE_CONTINUE;
+}
+
+static gboolean on_relay_announce_timer(gpointer user_data) {
+    Monitor *monitor = user_data;
+    for (size_t i = 0; i < target_store_count(&monitor->targets); ++i) {
+        Target *target = target_store_at(&monitor->targets, i);
+        if (!target->remote && target->relay_announced) {
+            relay_sender_announce(monitor->relay_sender, target->id, target->display);
+        }
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+static void open_relay(Monitor *monitor, const MonitorOptions *options) {
+    char error[128];
+    if (options->relay_to != NULL) {
+        char vantage[VANTAGE_NAME_LEN];
+        snprintf(vantage, sizeof(vantage), "%s", options->vantage != NULL ? options->vantage : g_get_host_name());
+        monitor->relay_sender = relay_sender_new(options->relay_to, vantage, error, sizeof(error));
+        if (monitor->relay_sender != NULL) {
+            monitor->relay_flush_id = g_timeout_add(RELAY_FLUSH_MS, on_relay_flush, monitor);
+            monitor->relay_announce_id = g_timeout_add_seconds(RELAY_ANNOUNCE_SEC, on_relay_announce_timer, monitor);
+            monitor_log(monitor, "Sending results to aggregator %s as vantage point %s", options->relay_to, vantage);
+        } else {
+            monitor_log(monitor, "Could not reach aggregator %s: %s", options->relay_to, error);
+        }
+    }
+    if (options->relay_listen != NULL) {
+        RelayHandlers handlers = {
+            .announce = on_relay_announce,
+            .results = on_relay_results,
+        };
+        monitor->relay_receiver = relay_receiver_new(options->relay_listen, &handlers, monitor, error, sizeof(error));
+        if (monitor->relay_receiver != NULL) {
+            monitor->vantages = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                                      (GDestroyNotify)g_hash_table_destroy);
+            monitor_log(monitor, "Aggregating agent results on UDP %s", options->relay_listen);
+        } else {
+            monitor_log(monitor, "Could not listen for agents on %s: %s", options->relay_listen, error);
+        }
+    }
+}
+
+static void close_relay(Monitor *monitor) {
+    if (monitor->relay_sender != NULL) {
+        g_source_remove(monitor->relay_flush_id);
+        g_source_remove(monitor->relay_announce_id);
+        monitor->relay_flush_id = 0;
+        monitor->relay_announce_id = 0;
+        relay_sender_free(monitor->relay_sender);
+        monitor->relay_sender = NULL;
+    }
+    relay_receiver_free(monitor->relay_receiver);
+    monitor->relay_receiver = NULL;
+    if (monitor->vantages != NULL) {
+        g_hash_table_destroy(monitor->vantages);
+        monitor->vantages = NULL;
+    }
+}
+
+static void print_usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [options] [target1 target2 ...]\n"
+            "Options:\n"
+            "  -i <seconds>    Ping interval in seconds (default: %d)\n"
+            "  -f <file>       Load targets from file (one per line)\n"
+            "  -b <url>        Optional backend probe endpoint URL\n"
+            "  -e <engine>     Ping engine: native (in-process ICMP, default) or ping\n"
+            "  -l <file>       Mirror the activity log to a rotating file\n"
+            "  -d <file>       Keep probe history in a memory-mapped file across restarts\n"
+            "  -w <seconds>    Window for p50/p95/p99 and jitter (default: %d)\n"
+            "  -m <[addr:]port> Serve OpenMetrics on /metrics (address defaults to 127.0.0.1)\n"
+            "  -r <probes/sec> Global probe rate budget (default: unlimited)\n"
+            "  -k              Reuse kept-alive connections for HTTP target probes\n"
+            "  -c <count>      Echoes per ICMP probe, reported with loss and jitter (default: 1)\n"
+            "  -s <ms>         Spacing between the echoes of a burst (default: %d)\n"
+            "  -I <seconds>    Adaptive intervals: back stable targets off up to this interval\n"
+            "  -a <sink>       Send status changes to exec:<command>, file:<path> or an http(s):// webhook\n"
+            "  -A <host:port>  Agent mode: stream probe results to an aggregator over UDP\n"
+            "  -V <name>       Vantage point name sent to the aggregator (default: host name)\n"
+            "  -L <[addr:]port> Aggregator mode: merge results from agents (address defaults to 127.0.0.1)\n"
+            "  --headless      Run without a window and print NDJSON events to stdout\n"
+            "  -h              Show this help\n",
+            prog, DEFAULT_INTERVAL_SEC, DEFAULT_STATS_WINDOW_SEC, DEFAULT_BURST_SPACING_MS);
+}
+
+int monitor_parse_options(MonitorOptions *options, int argc, char **argv) {
+    memset(options, 0, sizeof(*options));
+    options->interval_sec = DEFAULT_INTERVAL_SEC;
+    options->stats_window_sec = DEFAULT_STATS_WINDOW_SEC;
+    options->engine = PROBE_ENGINE_NATIVE;
+
+    static const struct option long_options[] = {
+        {"headless", no_argument, NULL, 'H'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "hi:f:b:e:l:d:w:m:r:kc:s:I:a:A:V:L:", long_options, NULL)) != -1) {
+        switch (opt) {
+        case 'h':
+            print_usage(argv[0]);
+            return 0;
+        case 'i':
+            options->interval_sec = atoi(optarg);
+            if (options->interval_sec <= 0) {
+                fprintf(stderr, "Invalid interval: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'f':
+            options->input_file = optarg;
+            break;
+        case 'b':
+            options->backend_url = optarg;
+            break;
+        case 'l':
+            options->log_file = optarg;
+            break;
+        case 'd':
+            options->history_file = optarg;
+            break;
+        case 'k':
+            options->http_reuse = true;
+            break;
+        case 'c':
+            options->burst_count = atoi(optarg);
+            if (options->burst_count < 1 || options->burst_count > MAX_BURST_COUNT) {
+                fprintf(stderr, "Invalid burst count (1-%d): %s\n", MAX_BURST_COUNT, optarg);
+                return 1;
+            }
+            break;
+        case 's':
+            options->burst_spacing_ms = atoi(optarg);
+            if (options->burst_spacing_ms <= 0) {
+                fprintf(stderr, "Invalid burst spacing: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'I':
+            options->adaptive_max_sec = atoi(optarg);
+            if (options->adaptive_max_sec <= 0) {
+                fprintf(stderr, "Invalid adaptive interval ceiling: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'r':
+            options->probe_rate = g_ascii_strtod(optarg, NULL);
+            if (options->probe_rate <= 0.0) {
+                fprintf(stderr, "Invalid probe rate: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'm':
+            options->metrics_listen = optarg;
+            break;
+        case 'A':
+            options->relay_to = optarg;
+            break;
+        case 'V':
+            if (strlen(optarg) == 0 || strlen(optarg) >= VANTAGE_NAME_LEN) {
+                fprintf(stderr, "Invalid vantage name (1-%d characters): %s\n", VANTAGE_NAME_LEN - 1, optarg);
+                return 1;
+            }
+            options->vantage = optarg;
+            break;
+        case 'L':
+            options->relay_listen = optarg;
+            break;
+        case 'a':
+            if (options->alert_sink_count >= MAX_ALERT_SINKS || !alert_pipeline_valid_sink(optarg)) {
+                fprintf(stderr, "Invalid alert sink (at most %d of exec:<command>, file:<path>, http(s)://): %s\n",
+                        MAX_ALERT_SINKS, optarg);
+                return 1;
+            }
+            options->alert_sinks[options->alert_sink_count++] = optarg;
+            break;
+        case 'w':
+            options->stats_window_sec = atoi(optarg);
+            if (options->stats_window_sec <= 0) {
+                fprintf(stderr, "Invalid stats window: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'e':
+            if (strcmp(optarg, "native") == 0) {
+                options->engine = PROBE_ENGINE_NATIVE;
+            } else if (strcmp(optarg, "ping") == 0) {
+                options->engine = PROBE_ENGINE_PING;
+            } else {
+                fprintf(stderr, "Invalid engine: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'H':
+            options->headless = true;
+            break;
+        default:
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    options->targets = argv + optind;
+    options->target_count = argc - optind;
+    return -1;
+}
+
+void monitor_init(Monitor *monitor, const MonitorCallbacks *callbacks) {
+    memset(monitor, 0, sizeof(*monitor));
+    target_store_init(&monitor->targets);
+    monitor->interval_sec = DEFAULT_INTERVAL_SEC;
+    if (callbacks != NULL) {
+        monitor->callbacks = *callbacks;
+    }
+
+    g_mutex_init(&monitor->results_lock);
+    monitor->finished_jobs = g_ptr_array_new();
+    monitor->ready = g_queue_new();
+    monitor->due = g_ptr_array_new();
+    monitor->resolving = g_queue_new();
+    monitor->http = http_client_new();
+    monitor->probe_pool = g_thread_pool_new(probe_worker, monitor, MAX_PROBE_WORKERS, FALSE, NULL);
+}
+
+void monitor_configure(Monitor *monitor, const MonitorOptions *options) {
+    monitor->interval_sec = options->interval_sec;
+    monitor->probe_rate = options->probe_rate;
+    monitor->http_reuse = options->http_reuse;
+    monitor->burst_count = options->burst_count;
+    monitor->burst_spacing_ms = options->burst_spacing_ms;
+    monitor->adaptive_max_ms = options->adaptive_max_sec * 1000;
+    monitor->targets.stats_window_sec = options->stats_window_sec;
+    monitor->engine = options->engine;
+    if (options->backend_url != NULL) {
+        monitor_set_backend_url(monitor, options->backend_url);
+    }
+    if (options->log_file != NULL) {
+        monitor->log_writer = log_writer_open(options->log_file, LOG_FILE_MAX_BYTES, LOG_FILE_KEEP);
+        if (monitor->log_writer == NULL) {
+            monitor_log(monitor, "Could not open log file %s; file logging disabled.", options->log_file);
+        }
+    }
+    if (options->history_file != NULL) {
+        open_history(monitor, options->history_file);
+    }
+    if (options->metrics_listen != NULL) {
+        char error[128];
+        monitor->metrics = metrics_server_new(options->metrics_listen, monitor_render_metrics, monitor, error,
+                                              sizeof(error));
+        if (monitor->metrics != NULL) {
+            monitor_log(monitor, "Serving metrics on %s/metrics", options->metrics_listen);
+        } else {
+            monitor_log(monitor, "Could not listen for metrics on %s: %s", options->metrics_listen, error);
+        }
+    }
+
+    open_relay(monitor, options);
+    if (options->alert_sink_count > 0) {
+        monitor->alerts = alert_pipeline_new();
+        for (int i = 0; i < options->alert_sink_count; ++i) {
+            char error[128];
+            if (alert_pipeline_add_sink(monitor->alerts, options->alert_sinks[i], error, sizeof(error))) {
+                monitor_log(monitor, "Sending status changes to %s", options->alert_sinks[i]);
+            } else {
+                monitor_log(monitor, "Could not add alert sink %s: %s", options->alert_sinks[i], error);
+            }
+        }
+        alert_pipeline_start(monitor->alerts);
+    }
+
+    if (monitor->engine == PROBE_ENGINE_NATIVE) {
+        monitor->icmp_ready = icmp_engine_open(&monitor->icmp);
+        if (!monitor->icmp_ready) {
+            monitor->engine = PROBE_ENGINE_PING;
+            monitor_log(monitor, "Native ICMP sockets unavailable; falling back to the ping command.");
+        }
+    }
+    int family = AF_UNSPEC;
+    if (monitor->engine == PROBE_ENGINE_NATIVE && monitor->icmp.fd4 < 0) {
+        family = AF_INET6;
+    } else if (monitor->engine == PROBE_ENGINE_NATIVE && monitor->icmp.fd6 < 0) {
+        family = AF_INET;
+    }
+    monitor->dns = dns_cache_new(family);
+
+    for (int i = 0; i < options->target_count; ++i) {
+        monitor_add_target(monitor, options->targets[i], false);
+    }
+    if (options->input_file != NULL) {
+        monitor->config_specs = new_spec_table();
+        load_config_file(monitor, options->input_file, monitor->config_specs);
+        monitor_log(monitor, "Loaded %u targets from %s", g_hash_table_size(monitor->config_specs),
+                    options->input_file);
+        monitor->config_path = g_strdup(options->input_file);
+        monitor->config_watch = config_watch_new(options->input_file, CONFIG_RELOAD_DEBOUNCE_MS, on_config_changed,
+                                                 monitor);
+        if (monitor->config_watch == NULL) {
+            monitor_log(monitor, "Could not watch %s; changes take effect after a restart.", options->input_file);
+        }
+    }
+
+    if (monitor_load_config(monitor, CONFIG_PATH)) {
+        monitor_log(monitor, "Loaded saved configuration from %s", CONFIG_PATH);
+    }
+
+    if (options->backend_url != NULL) {
+        monitor_set_backend_url(monitor, options->backend_url);
+    }
+    prune_history(monitor);
+}
+
+void monitor_shutdown(Monitor *monitor) {
+    monitor_stop(monitor);
+    config_watch_free(monitor->config_watch);
+    monitor->config_watch = NULL;
+    if (monitor->config_specs != NULL) {
+        g_hash_table_destroy(monitor->config_specs);
+        monitor->config_specs = NULL;
+    }
+    g_free(monitor->config_path);
+    monitor->config_path = NULL;
+    g_atomic_int_set(&monitor->shutting_down, 1);
+    g_thread_pool_free(monitor->probe_pool, FALSE, TRUE);
+    monitor->probe_pool = NULL;
+    http_client_free(monitor->http);
+    monitor->http = NULL;
+    if (monitor->icmp_ready) {
+        icmp_engine_close(&monitor->icmp);
+        monitor->icmp_ready = false;
+    }
+    /* Every job has now run, been skipped or been cancelled, and sits in finished_jobs unrecorded. */
+    g_mutex_lock(&monitor->results_lock);
+    GPtrArray *jobs = monitor->finished_jobs;
+    monitor->finished_jobs = NULL;
+    if (monitor->flush_source_id != 0) {
+        g_source_remove(monitor->flush_source_id);
+        monitor->flush_source_id = 0;
+    }
+    g_mutex_unlock(&monitor->results_lock);
+    for (guint i = 0; i < jobs->len; ++i) {
+        free_probe_job(g_ptr_array_index(jobs, i));
+    }
+    g_ptr_array_free(jobs, TRUE);
+    monitor->jobs_in_flight = 0;
+    g_mutex_clear(&monitor->results_lock);
+    if (monitor->updated_source_id != 0) {
+        g_source_remove(monitor->updated_source_id);
+        monitor->updated_source_id = 0;
+    }
+    if (monitor->history_ready) {
+        g_source_remove(monitor->history_sync_id);
+        monitor->history_sync_id = 0;
+        g_hash_table_destroy(monitor->history_slots);
+        monitor->history_slots = NULL;
+        history_file_close(&monitor->history);
+        monitor->history_ready = false;
+    }
+    metrics_server_free(monitor->metrics);
+    monitor->metrics = NULL;
+    close_relay(monitor);
+    alert_pipeline_free(monitor->alerts);
+    monitor->alerts = NULL;
+    if (monitor->metrics_stats != NULL) {
+        g_array_free(monitor->metrics_stats, TRUE);
+        monitor->metrics_stats = NULL;
+    }
+    g_queue_free(monitor->ready);
+    monitor->ready = NULL;
+    g_ptr_array_free(monitor->due, TRUE);
+    monitor->due = NULL;
+    g_queue_free(monitor->resolving);
+    monitor->resolving = NULL;
+    dns_cache_free(monitor->dns);
+    monitor->dns = NULL;
+    log_writer_close(monitor->log_writer);
+    monitor->log_writer = NULL;
+}
@@ -0,0 +1,159 @@
+#ifndef NETPULSE_MONITOR_H
+#define NETPULSE_MONITOR_H
+
+#include <glib.h>
+#include <stdbool.h>
+
+#include "netpulse_alerts.h"
+#include "netpulse_config.h"
+#include "netpulse_diagnostics.h"
+#include "netpulse_history.h"
+#include "netpulse_http.h"
+#include "netpulse_icmp.h"
+#include "netpulse_json.h"
+#include "netpulse_log.h"
+#include "netpulse_metrics.h"
+#include "netpulse_relay.h"
+#include "netpulse_resolver.h"
+#include "netpulse_scheduler.h"
+#include "netpulse_targets.h"
+#include "netpulse_tcp.h"
+
+#define DEFAULT_INTERVAL_SEC 3
+#define PING_TIMEOUT_SEC 1
+#define TCP_TIMEOUT_SEC 2
+#define DEFAULT_BURST_SPACING_MS 100
+#define MAX_BURST_COUNT 100
+#define ADAPTIVE_STABLE_SAMPLES 10
+#define MAX_PROBE_WORKERS 16
+#define CONFIG_PATH "netpulse_c_config.txt"
+#define HISTORY_SYNC_SEC 5
+
+typedef enum {
+    PROBE_ENGINE_NATIVE,
+    PROBE_ENGINE_PING,
+} ProbeEngine;
+
+typedef struct {
+    int interval_sec;
+    int stats_window_sec;
+    double probe_rate;
+    bool http_reuse;
+    int burst_count;
+    int burst_spacing_ms;
+    int adaptive_max_sec;
+    const char *input_file;
+    const char *backend_url;
+    const char *log_file;
+    const char *history_file;
+    const char *metrics_listen;
+    const char *relay_to;
+    const char *relay_listen;
+    const char *vantage;
+    const char *alert_sinks[MAX_ALERT_SINKS];
+    int alert_sink_count;
+    ProbeEngine engine;
+    bool headless;
+    char **targets;
+    int target_count;
+} MonitorOptions;
+
+typedef struct {
+    void (*log)(const char *timestamp, const char *message, gpointer user_data);
+    void (*sample)(Target *target, gpointer user_data);
+    void (*updated)(gpointer user_data);
+    void (*tick)(int64_t duration_ns, gpointer user_data);
+    gpointer user_data;
+} MonitorCallbacks;
+
+typedef struct {
+    guint64 ticks;
+    guint64 probes_skipped;
+    guint64 probes_deferred;
+    guint64 probes;
+    guint64 probe_failures;
+    guint64 tcp_refused;
+    guint64 tcp_timeouts;
+    guint64 ticks_overrun;
+    guint64 ticks_late;
+    guint64 ticks_missed;
+    guint64 spawn_errors;
+    guint64 socket_errors;
+    guint64 relay_unknown;
+    guint64 adaptive_backoffs;
+    guint64 adaptive_tightened;
+    guint64 scrapes;
+} MonitorCounters;
+
+typedef struct Monitor {
+    TargetStore targets;
+    int interval_sec;
+    double probe_rate;
+    bool http_reuse;
+    int burst_count;
+    int burst_spacing_ms;
+    int adaptive_max_ms;
+    guint timer_id;
+    TimerWheel wheel;
+    TokenBucket budget;
+    /* Bumped whenever the budget runs out with probes still queued. */
+    guint64 budget_denials;
+    GQueue *ready;
+    GPtrArray *due;
+    GQueue *resolving;
+    DnsCache *dns;
+    bool monitoring;
+    bool auto_start;
+    char probe_backend_url[512];
+    ProbeEngine engine;
+    IcmpEngine icmp;
+    bool icmp_ready;
+    MonitorCallbacks callbacks;
+    LogWriter *log_writer;
+    HistoryFile history;
+    bool history_ready;
+    GHashTable *history_slots;
+    guint history_sync_id;
+    MetricsServer *metrics;
+    GArray *metrics_stats;
+    AlertPipeline *alerts;
+    RelaySender *relay_sender;
+    RelayReceiver *relay_receiver;
+    GHashTable *vantages;
+    guint relay_flush_id;
+    guint relay_announce_id;
+    char *config_path;
+    GHashTable *config_specs;
+    ConfigWatch *config_watch;
+    MonitorCounters counters;
+    MonitorDiagnostics diag;
+
+    HttpClient *http;
+    GThreadPool *probe_pool;
+    gint shutting_down;
+    int jobs_in_flight;
+    GMutex results_lock;
+    GPtrArray *finished_jobs;
+    guint flush_source_id;
+    guint updated_source_id;
+    char batch_backend_url[512];
+} Monitor;
+
+int monitor_parse_options(MonitorOptions *options, int argc, char **argv);
+
+void monitor_init(Monitor *monitor, const MonitorCallbacks *callbacks);
+void monitor_configure(Monitor *monitor, const MonitorOptions *options);
+void monitor_shutdown(Monitor *monitor);
+
+void monitor_log(Monitor *monitor, const char *fmt, ...) G_GNUC_PRINTF(2, 3);
+Target *monitor_add_target(Monitor *monitor, const char *raw_target, bool log_result);
+void monitor_remove_target(Monitor *monitor, unsigned int id);
+void monitor_set_backend_url(Monitor *monitor, const char *url);
+bool monitor_load_config(Monitor *monitor, const char *path);
+bool monitor_save_config(const Monitor *monitor, const char *path);
+
+void monitor_start(Monitor *monitor);
+void monitor_stop(Monitor *monitor);
+void monitor_describe_diagnostics(const Monitor *monitor, GString *out);
+
+#endif
@@ -0,0 +1,376 @@
+#define _GNU_SOURCE
+#include "netpulse_relay.h"
+
+#include <errno.h>
+#include <glib-unix.h>
+#include <netdb.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/* Wire format, integers big-endian. Every datagram starts with
+     u16 magic "NP", u8 version, u8 type, u32 sequence, u64 base time in ms, u8 vantage length, vantage
+   and then holds records of its type only:
+     results:  u32 target id, u16 ms after the base time, u8 flags, u8 reserved, u32 latency in us
+     announce: u32 target id, u8 name length, name
+   A result is 12 bytes, so one datagram carries about 110 of them. */
+#define RELAY_MAGIC 0x4E50
+#define RELAY_VERSION 1
+#define RELAY_HEADER_SIZE 17
+#define RELAY_RESULT_SIZE 12
+#define RELAY_RECV_BUFFER (4 * 1024 * 1024)
+#define RELAY_MAX_RECV_ROUNDS 16
+
+enum {
+    RELAY_TYPE_RESULTS = 1,
+    RELAY_TYPE_ANNOUNCE = 2,
+};
+
+enum {
+    RELAY_FLAG_OK = 1,
+    RELAY_FLAG_LATENCY = 2,
+};
+
+typedef struct {
+    uint8_t data[RELAY_MAX_DATAGRAM];
+    size_t len;
+    int64_t base_ms;
+} RelayPacket;
+
+struct RelaySender {
+    int fd;
+    char vantage[VANTAGE_NAME_LEN];
+    size_t header_len;
+    uint32_t sequence;
+    RelayPacket results;
+    RelayPacket announce;
+};
+
+struct RelayReceiver {
+    int fd;
+    guint source_id;
+    RelayHandlers handlers;
+    gpointer user_data;
+    RelayStats stats;
+    GHashTable *next_sequence;
+    uint8_t buffers[RELAY_RECV_BATCH][RELAY_MAX_DATAGRAM];
+    RelayResult results[RELAY_MAX_DATAGRAM / RELAY_RESULT_SIZE];
+};
+
+static void put_u16(uint8_t *p, uint16_t value) {
+    p[0] = (uint8_t)(value >> 8);
+    p[1] = (uint8_t)value;
+}
+
+static void put_u32(uint8_t *p, uint32_t value) {
+    put_u16(p, (uint16_t)(value >> 16));
+    put_u16(p + 2, (uint16_t)value);
+}
+
+static void put_u64(uint8_t *p, uint64_t value) {
+    put_u32(p, (uint32_t)(value >> 32));
+    put_u32(p + 4, (uint32_t)value);
+}
+
+static uint16_t get_u16(const uint8_t *p) {
+    return (uint16_t)(p[0] << 8 | p[1]);
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+    return (uint32_t)get_u16(p) << 16 | get_u16(p + 2);
+}
+
+static uint64_t get_u64(const uint8_t *p) {
+    return (uint64_t)get_u32(p) << 32 | get_u32(p + 4);
+}
+
+/* Accepts "port", "host:port" or "[v6]:port"; the host defaults to loopback. */
+static int open_udp_socket(const char *address, bool passive, char *error, size_t error_size) {
+    char host[256];
+    const char *port = address;
+    snprintf(host, sizeof(host), "%s", RELAY_DEFAULT_HOST);
+
+    const char *colon = strrchr(address, ':');
+    if (colon != NULL) {
+        const char *start = address;
+        size_t len = (size_t)(colon - address);
+        if (len >= 2 && start[0] == '[' && start[len - 1] == ']') {
+            start++;
+            len -= 2;
+        }
+        snprintf(host, sizeof(host), "%.*s", (int)len, start);
+        port = colon + 1;
+    }
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_flags = (passive ? AI_PASSIVE : 0) | AI_NUMERICSERV;
+    struct addrinfo *result = NULL;
+    int rc = getaddrinfo(host[0] != '\0' ? host : NULL, port, &hints, &result);
+    if (rc != 0) {
+        snprintf(error, error_size, "%s", gai_strerror(rc));
+        return -1;
+    }
+
+    int fd = -1;
+    snprintf(error, error_size, "no usable address");
+    for (struct addrinfo *ai = result; ai != NULL; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, ai->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+        if (passive) {
+            int size = RELAY_RECV_BUFFER;
+            setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+        }
+        if ((passive ? bind(fd, ai->ai_addr, ai->ai_addrlen) : connect(fd, ai->ai_addr, ai->ai_addrlen)) == 0) {
+            break;
+        }
+        snprintf(error, error_size, "%s", strerror(errno));
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(result);
+    return fd;
+}
+
+RelaySender *relay_sender_new(const char *address, const char *vantage, char *error, size_t error_size) {
+    size_t vantage_len = strlen(vantage);
+    if (vantage_len == 0 || vantage_len >= VANTAGE_NAME_LEN) {
+        snprintf(error, error_size, "vantage name must be 1-%d characters", VANTAGE_NAME_LEN - 1);
+        return NULL;
+    }
+    int fd = open_udp_socket(address, false, error, error_size);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    RelaySender *sender = g_new0(RelaySender, 1);
+    sender->fd = fd;
+    memcpy(sender->vantage, vantage, vantage_len + 1);
+    sender->header_len = RELAY_HEADER_SIZE + vantage_len;
+    return sender;
+}
+
+static void begin_packet(RelaySender *sender, RelayPacket *packet, uint8_t type, int64_t base_ms) {
+    uint8_t *p = packet->data;
+    size_t vantage_len = sender->header_len - RELAY_HEADER_SIZE;
+    put_u16(p, RELAY_MAGIC);
+    p[2] = RELAY_VERSION;
+    p[3] = type;
+    put_u64(p + 8, (uint64_t)base_ms);
+    p[16] = (uint8_t)vantage_len;
+    memcpy(p + RELAY_HEADER_SIZE, sender->vantage, vantage_len);
+    packet->len = sender->header_len;
+    packet->base_ms = base_ms;
+}
+
+/* Sequence numbers are stamped at send time so the aggregator can count datagrams lost on the way. A
+   full socket buffer drops the datagram like the network would. */
+static void send_packet(RelaySender *sender, RelayPacket *packet) {
+    if (packet->len > sender->header_len) {
+        put_u32(packet->data + 4, sender->sequence++);
+        while (send(sender->fd, packet->data, packet->len, MSG_DONTWAIT) < 0 && errno == EINTR) {
+        }
+    }
+    packet->len = 0;
+}
+
+/* Announcements go first so a fresh aggregator learns the names before the results that use them. */
+void relay_sender_flush(RelaySender *sender) {
+    send_packet(sender, &sender->announce);
+    send_packet(sender, &sender->results);
+}
+
+void relay_sender_announce(RelaySender *sender, uint32_t target_id, const char *name) {
+    size_t name_len = MIN(strlen(name), 255);
+    RelayPacket *packet = &sender->announce;
+    if (packet->len > 0 && packet->len + 5 + name_len > RELAY_MAX_DATAGRAM) {
+        send_packet(sender, packet);
+    }
+    if (packet->len == 0) {
+        begin_packet(sender, packet, RELAY_TYPE_ANNOUNCE, 0);
+    }
+    uint8_t *p = packet->data + packet->len;
+    put_u32(p, target_id);
+    p[4] = (uint8_t)name_len;
+    memcpy(p + 5, name, name_len);
+    packet->len += 5 + name_len;
+}
+
+void relay_sender_add(RelaySender *sender, const RelayResult *result) {
+    RelayPacket *packet = &sender->results;
+    int64_t offset_ms = result->timestamp_ms - packet->base_ms;
+    if (packet->len > 0 && (offset_ms < 0 || offset_ms > UINT16_MAX)) {
+        relay_sender_flush(sender);
+    }
+    if (packet->len == 0) {
+        begin_packet(sender, packet, RELAY_TYPE_RESULTS, result->timestamp_ms);
+        offset_ms = 0;
+    }
+
+    double latency_us = result->has_latency ? result->latency_ms * 1000.0 + 0.5 : 0.0;
+    uint8_t *p = packet->data + packet->len;
+    put_u32(p, result->target_id);
+    put_u16(p + 4, (uint16_t)offset_ms);
+    p[6] = (uint8_t)((result->ok ? RELAY_FLAG_OK : 0) | (result->has_latency ? RELAY_FLAG_LATENCY : 0));
+    p[7] = 0;
+    put_u32(p + 8, latency_us < (double)UINT32_MAX ? (uint32_t)latency_us : UINT32_MAX);
+    packet->len += RELAY_RESULT_SIZE;
+    if (packet->len + RELAY_RESULT_SIZE > RELAY_MAX_DATAGRAM) {
+        relay_sender_flush(sender);
+    }
+}
+
+void relay_sender_free(RelaySender *sender) {
+    if (sender == NULL) {
+        return;
+    }
+    relay_sender_flush(sender);
+    close(sender->fd);
+    g_free(sender);
+}
+
+static void track_sequence(RelayReceiver *receiver, const char *vantage, uint32_t sequence) {
+    uint32_t *expected = g_hash_table_lookup(receiver->next_sequence, vantage);
+    if (expected == NULL) {
+        expected = g_new(uint32_t, 1);
+        g_hash_table_insert(receiver->next_sequence, g_strdup(vantage), expected);
+    } else {
+        uint32_t gap = sequence - *expected;
+        /* A large jump either way is an agent restart, not loss. */
+        if (gap > 0 && gap < 65536) {
+            receiver->stats.lost += gap;
+        }
+    }
+    *expected = sequence + 1;
+}
+
+static bool parse_results(RelayReceiver *receiver, const char *vantage, int64_t base_ms, const uint8_t *p,
+                          size_t len) {
+    if (len % RELAY_RESULT_SIZE != 0) {
+        return false;
+    }
+    size_t count = len / RELAY_RESULT_SIZE;
+    for (size_t i = 0; i < count; ++i, p += RELAY_RESULT_SIZE) {
+        RelayResult *result = &receiver->results[i];
+        result->target_id = get_u32(p);
+        result->timestamp_ms = base_ms + get_u16(p + 4);
+        result->ok = (p[6] & RELAY_FLAG_OK) != 0;
+        result->has_latency = (p[6] & RELAY_FLAG_LATENCY) != 0;
+        result->latency_ms = get_u32(p + 8) / 1000.0;
+    }
+    receiver->stats.results += count;
+    if (count > 0) {
+        receiver->handlers.results(vantage, receiver->results, count, receiver->user_data);
+    }
+    return true;
+}
+
+static bool parse_announce(RelayReceiver *receiver, const char *vantage, const uint8_t *p, size_t len) {
+    char name[256];
+    while (len > 0) {
+        if (len < 5 || len < 5 + (size_t)p[4]) {
+            return false;
+        }
+        size_t name_len = p[4];
+        memcpy(name, p + 5, name_len);
+        name[name_len] = '\0';
+        receiver->stats.announcements++;
+        receiver->handlers.announce(vantage, get_u32(p), name, receiver->user_data);
+        p += 5 + name_len;
+        len -= 5 + name_len;
+    }
+    return true;
+}
+
+static bool parse_datagram(RelayReceiver *receiver, const uint8_t *data, size_t len) {
+    if (len < RELAY_HEADER_SIZE || get_u16(data) != RELAY_MAGIC || data[2] != RELAY_VERSION) {
+        return false;
+    }
+    size_t vantage_len = data[16];
+    if (vantage_len == 0 || vantage_len >= VANTAGE_NAME_LEN || RELAY_HEADER_SIZE + vantage_len > len) {
+        return false;
+    }
+    char vantage[VANTAGE_NAME_LEN];
+    memcpy(vantage, data + RELAY_HEADER_SIZE, vantage_len);
+    vantage[vantage_len] = '\0';
+
+    track_sequence(receiver, vantage, get_u32(data + 4));
+    const uint8_t *records = data + RELAY_HEADER_SIZE + vantage_len;
+    size_t records_len = len - RELAY_HEADER_SIZE - vantage_len;
+    switch (data[3]) {
+    case RELAY_TYPE_RESULTS:
+        return parse_results(receiver, vantage, (int64_t)get_u64(data + 8), records, records_len);
+    case RELAY_TYPE_ANNOUNCE:
+        return parse_announce(receiver, vantage, records, records_len);
+    default:
+        return false;
+    }
+}
+
+/* Drains the socket with recvmmsg, RELAY_RECV_BATCH datagrams per system call, and yields to the main loop
+   after a bounded number of rounds so a flood cannot starve the scheduler. */
+static gboolean on_relay_readable(gint fd, GIOCondition condition, gpointer user_data) {
+    (void)condition;
+    RelayReceiver *receiver = user_data;
+    struct mmsghdr messages[RELAY_RECV_BATCH];
+    struct iovec iov[RELAY_RECV_BATCH];
+    for (int round = 0; round < RELAY_MAX_RECV_ROUNDS; ++round) {
+        memset(messages, 0, sizeof(messages));
+        for (int i = 0; i < RELAY_RECV_BATCH; ++i) {
+            iov[i].iov_base = receiver->buffers[i];
+            iov[i].iov_len = sizeof(receiver->buffers[i]);
+            messages[i].msg_hdr.msg_iov = &iov[i];
+            messages[i].msg_hdr.msg_iovlen = 1;
+        }
+        int received = recvmmsg(fd, messages, RELAY_RECV_BATCH, MSG_DONTWAIT, NULL);
+        if (received <= 0) {
+            break;
+        }
+        for (int i = 0; i < received; ++i) {
+            receiver->stats.datagrams++;
+            bool truncated = (messages[i].msg_hdr.msg_flags & MSG_TRUNC) != 0;
+            if (truncated || !parse_datagram(receiver, receiver->buffers[i], messages[i].msg_len)) {
+                receiver->stats.malformed++;
+            }
+        }
+        if (received < RELAY_RECV_BATCH) {
+            break;
+        }
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+RelayReceiver *relay_receiver_new(const char *listen_addr, const RelayHandlers *handlers, gpointer user_data,
+                                  char *error, size_t error_size) {
+    int fd = open_udp_socket(listen_addr, true, error, error_size);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    RelayReceiver *receiver = g_new0(RelayReceiver, 1);
+    receiver->fd = fd;
+    receiver->handlers = *handlers;
+    receiver->user_data = user_data;
+    receiver->next_sequence = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    receiver->source_id = g_unix_fd_add(fd, G_IO_IN, on_relay_readable, receiver);
+    return receiver;
+}
+
+const RelayStats *relay_receiver_stats(const RelayReceiver *receiver) {
+    return &receiver->stats;
+}
+
+void relay_receiver_free(RelayReceiver *receiver) {
+    if (receiver == NULL) {
+        return;
+    }
+    g_source_remove(receiver->source_id);
+    close(receiver->fd);
+    g_hash_table_destroy(receiver->next_sequence);
+    g_free(receiver);
+}
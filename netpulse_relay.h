@@ -0,0 +1,53 @@
+#ifndef NETPULSE_RELAY_H
+#define NETPULSE_RELAY_H
+
+#include <glib.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define RELAY_DEFAULT_HOST "127.0.0.1"
+#define RELAY_MAX_DATAGRAM 1400
+#define RELAY_FLUSH_MS 100
+#define RELAY_ANNOUNCE_SEC 10
+#define RELAY_RECV_BATCH 64
+#define VANTAGE_NAME_LEN 32
+
+/* One probe result as an agent reports it; target ids are the agent's own and are mapped to names by
+   announcements. */
+typedef struct {
+    uint32_t target_id;
+    int64_t timestamp_ms;
+    bool ok;
+    bool has_latency;
+    double latency_ms;
+} RelayResult;
+
+typedef struct {
+    void (*announce)(const char *vantage, uint32_t target_id, const char *name, gpointer user_data);
+    void (*results)(const char *vantage, const RelayResult *results, size_t count, gpointer user_data);
+} RelayHandlers;
+
+typedef struct {
+    guint64 datagrams;
+    guint64 results;
+    guint64 announcements;
+    guint64 malformed;
+    guint64 lost;
+} RelayStats;
+
+typedef struct RelaySender RelaySender;
+typedef struct RelayReceiver RelayReceiver;
+
+RelaySender *relay_sender_new(const char *address, const char *vantage, char *error, size_t error_size);
+void relay_sender_announce(RelaySender *sender, uint32_t target_id, const char *name);
+void relay_sender_add(RelaySender *sender, const RelayResult *result);
+void relay_sender_flush(RelaySender *sender);
+void relay_sender_free(RelaySender *sender);
+
+RelayReceiver *relay_receiver_new(const char *listen_addr, const RelayHandlers *handlers, gpointer user_data,
+                                  char *error, size_t error_size);
+const RelayStats *relay_receiver_stats(const RelayReceiver *receiver);
+void relay_receiver_free(RelayReceiver *receiver);
+
+#endif
@@ -0,0 +1,204 @@
+#define _GNU_SOURCE
+#include "netpulse_resolver.h"
+
+#include <netdb.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/socket.h>
+
+#define DNS_PRUNE_SEC 60
+
+typedef struct {
+    char *host;
+    struct addrinfo hints;
+    struct gaicb request;
+    struct sigevent notify;
+    bool pending;
+    gint done;
+    gint64 started_us;
+    gint64 finished_us;
+    gint64 expires_us;
+    gint64 last_used_us;
+    double resolve_ms;
+    bool has_address;
+    char address[DNS_ADDRESS_LEN];
+    int error;
+} DnsEntry;
+
+struct DnsCache {
+    int family;
+    GHashTable *entries;
+    GPtrArray *inflight;
+    gint64 next_prune_us;
+    DnsCounters counters;
+};
+
+static void free_entry(gpointer data) {
+    DnsEntry *entry = data;
+    if (entry->request.ar_result != NULL) {
+        freeaddrinfo(entry->request.ar_result);
+    }
+    g_free(entry->host);
+    g_free(entry);
+}
+
+/* Runs on a glibc resolver thread; only the completion time and the done flag are touched here. */
+static void on_lookup_done(union sigval value) {
+    DnsEntry *entry = value.sival_ptr;
+    entry->finished_us = g_get_monotonic_time();
+    g_atomic_int_set(&entry->done, 1);
+}
+
+static void fail_entry(DnsCache *cache, DnsEntry *entry, int error, gint64 now_us) {
+    /* A previously resolved address stays in use while the resolver keeps failing. */
+    entry->error = error;
+    entry->expires_us = now_us + (gint64)DNS_NEGATIVE_TTL_SEC * G_USEC_PER_SEC;
+    cache->counters.failures++;
+}
+
+static void submit_lookup(DnsCache *cache, DnsEntry *entry, gint64 now_us) {
+    memset(&entry->request, 0, sizeof(entry->request));
+    entry->request.ar_name = entry->host;
+    entry->request.ar_request = &entry->hints;
+    memset(&entry->notify, 0, sizeof(entry->notify));
+    entry->notify.sigev_notify = SIGEV_THREAD;
+    entry->notify.sigev_notify_function = on_lookup_done;
+    entry->notify.sigev_value.sival_ptr = entry;
+    entry->done = 0;
+    entry->started_us = now_us;
+    cache->counters.lookups++;
+
+    struct gaicb *list[1] = {&entry->request};
+    int rc = getaddrinfo_a(GAI_NOWAIT, list, 1, &entry->notify);
+    if (rc != 0) {
+        fail_entry(cache, entry, rc, now_us);
+        return;
+    }
+    entry->pending = true;
+    g_ptr_array_add(cache->inflight, entry);
+}
+
+static void complete_lookup(DnsCache *cache, DnsEntry *entry) {
+    entry->pending = false;
+    entry->resolve_ms = (double)(entry->finished_us - entry->started_us) / 1000.0;
+
+    int rc = gai_error(&entry->request);
+    struct addrinfo *res = entry->request.ar_result;
+    char address[DNS_ADDRESS_LEN];
+    if (rc == 0 && res != NULL) {
+        rc = getnameinfo(res->ai_addr, res->ai_addrlen, address, sizeof(address), NULL, 0, NI_NUMERICHOST);
+    } else if (rc == 0) {
+        rc = EAI_NONAME;
+    }
+
+    if (rc == 0) {
+        memcpy(entry->address, address, sizeof(address));
+        entry->has_address = true;
+        entry->error = 0;
+        entry->expires_us = entry->finished_us + (gint64)DNS_CACHE_TTL_SEC * G_USEC_PER_SEC;
+    } else {
+        fail_entry(cache, entry, rc, entry->finished_us);
+    }
+    if (res != NULL) {
+        freeaddrinfo(res);
+        entry->request.ar_result = NULL;
+    }
+}
+
+DnsCache *dns_cache_new(int family) {
+    DnsCache *cache = g_new0(DnsCache, 1);
+    cache->family = family;
+    cache->entries = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, free_entry);
+    cache->inflight = g_ptr_array_new();
+    cache->next_prune_us = g_get_monotonic_time() + (gint64)DNS_PRUNE_SEC * G_USEC_PER_SEC;
+    return cache;
+}
+
+void dns_cache_free(DnsCache *cache) {
+    if (cache == NULL) {
+        return;
+    }
+    /* A lookup that cannot be cancelled still owns its entry, so it is left behind rather than freed. */
+    for (guint i = 0; i < cache->inflight->len; ++i) {
+        DnsEntry *entry = g_ptr_array_index(cache->inflight, i);
+        if (gai_cancel(&entry->request) != EAI_CANCELED && !g_atomic_int_get(&entry->done)) {
+            g_hash_table_steal(cache->entries, entry->host);
+        }
+    }
+    g_ptr_array_free(cache->inflight, TRUE);
+    g_hash_table_destroy(cache->entries);
+    g_free(cache);
+}
+
+DnsState dns_cache_lookup(DnsCache *cache, const char *host, DnsAnswer *answer) {
+    gint64 now_us = g_get_monotonic_time();
+    gchar *key = g_ascii_strdown(host, -1);
+    DnsEntry *entry = g_hash_table_lookup(cache->entries, key);
+    if (entry == NULL) {
+        entry = g_new0(DnsEntry, 1);
+        entry->host = key;
+        entry->hints.ai_family = cache->family;
+        entry->hints.ai_socktype = SOCK_RAW;
+        g_hash_table_insert(cache->entries, entry->host, entry);
+        submit_lookup(cache, entry, now_us);
+    } else {
+        g_free(key);
+        if (!entry->pending && now_us >= entry->expires_us) {
+            submit_lookup(cache, entry, now_us);
+        } else if (entry->has_address) {
+            cache->counters.hits++;
+        }
+    }
+    entry->last_used_us = now_us;
+
+    answer->resolve_ms = entry->resolve_ms;
+    answer->error = NULL;
+    answer->address[0] = '\0';
+    if (entry->has_address) {
+        answer->state = DNS_RESOLVED;
+        memcpy(answer->address, entry->address, sizeof(answer->address));
+    } else if (entry->error != 0) {
+        answer->state = DNS_FAILED;
+        answer->error = gai_strerror(entry->error);
+    } else {
+        answer->state = DNS_PENDING;
+    }
+    return answer->state;
+}
+
+guint dns_cache_poll(DnsCache *cache) {
+    guint completed = 0;
+    for (guint i = 0; i < cache->inflight->len;) {
+        DnsEntry *entry = g_ptr_array_index(cache->inflight, i);
+        if (!g_atomic_int_get(&entry->done)) {
+            ++i;
+            continue;
+        }
+        g_ptr_array_remove_index_fast(cache->inflight, i);
+        complete_lookup(cache, entry);
+        completed++;
+    }
+
+    gint64 now_us = g_get_monotonic_time();
+    if (now_us >= cache->next_prune_us) {
+        cache->next_prune_us = now_us + (gint64)DNS_PRUNE_SEC * G_USEC_PER_SEC;
+        GHashTableIter iter;
+        gpointer value;
+        g_hash_table_iter_init(&iter, cache->entries);
+        while (g_hash_table_iter_next(&iter, NULL, &value)) {
+            DnsEntry *entry = value;
+            if (!entry->pending && now_us - entry->last_used_us > (gint64)DNS_IDLE_SEC * G_USEC_PER_SEC) {
+                g_hash_table_iter_remove(&iter);
+            }
+        }
+    }
+    return completed;
+}
+
+guint dns_cache_pending(const DnsCache *cache) {
+    return cache->inflight->len;
+}
+
+const DnsCounters *dns_cache_counters(const DnsCache *cache) {
+    return &cache->counters;
+}
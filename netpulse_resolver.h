@@ -0,0 +1,42 @@
+#ifndef NETPULSE_RESOLVER_H
+#define NETPULSE_RESOLVER_H
+
+#include <glib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* getaddrinfo() does not expose record TTLs, so answers are kept for a fixed time. */
+#define DNS_CACHE_TTL_SEC 300
+#define DNS_NEGATIVE_TTL_SEC 30
+#define DNS_IDLE_SEC 900
+#define DNS_ADDRESS_LEN 64
+
+typedef enum {
+    DNS_PENDING,
+    DNS_RESOLVED,
+    DNS_FAILED,
+} DnsState;
+
+typedef struct {
+    DnsState state;
+    char address[DNS_ADDRESS_LEN];
+    double resolve_ms;
+    const char *error;
+} DnsAnswer;
+
+typedef struct {
+    guint64 lookups;
+    guint64 failures;
+    guint64 hits;
+} DnsCounters;
+
+typedef struct DnsCache DnsCache;
+
+DnsCache *dns_cache_new(int family);
+void dns_cache_free(DnsCache *cache);
+DnsState dns_cache_lookup(DnsCache *cache, const char *host, DnsAnswer *answer);
+guint dns_cache_poll(DnsCache *cache);
+guint dns_cache_pending(const DnsCache *cache);
+const DnsCounters *dns_cache_counters(const DnsCache *cache);
+
+#endif
@@ -0,0 +1,127 @@
+#include "netpulse_scheduler.h"
+
+#include <string.h>
+
+#define WHEEL_MASK (WHEEL_SLOTS - 1)
+
+static void link_entry(TimerEntry **head, TimerEntry *entry) {
+    entry->slot = head;
+    entry->prev = NULL;
+    entry->next = *head;
+    if (*head != NULL) {
+        (*head)->prev = entry;
+    }
+    *head = entry;
+}
+
+static TimerEntry **slot_for(TimerWheel *wheel, uint64_t expires) {
+    uint64_t delta = expires - wheel->now;
+    for (int level = 0; level < WHEEL_LEVELS; ++level) {
+        unsigned int shift = (unsigned int)(level * WHEEL_SLOT_BITS);
+        if (delta < ((uint64_t)1 << (shift + WHEEL_SLOT_BITS)) || level == WHEEL_LEVELS - 1) {
+            if (level == WHEEL_LEVELS - 1 && delta >= ((uint64_t)1 << (shift + WHEEL_SLOT_BITS))) {
+                expires = wheel->now + ((uint64_t)1 << (shift + WHEEL_SLOT_BITS)) - 1;
+            }
+            return &wheel->slots[level][(expires >> shift) & WHEEL_MASK];
+        }
+    }
+    return NULL;
+}
+
+void timer_wheel_init(TimerWheel *wheel, uint64_t now_tick) {
+    memset(wheel, 0, sizeof(*wheel));
+    wheel->now = now_tick;
+}
+
+void timer_wheel_schedule(TimerWheel *wheel, TimerEntry *entry, uint64_t expires_tick) {
+    if (entry->armed) {
+        timer_wheel_cancel(wheel, entry);
+    }
+    entry->expires = expires_tick > wheel->now ? expires_tick : wheel->now + 1;
+    entry->armed = true;
+    link_entry(slot_for(wheel, entry->expires), entry);
+    wheel->armed++;
+}
+
+void timer_wheel_cancel(TimerWheel *wheel, TimerEntry *entry) {
+    if (!entry->armed) {
+        return;
+    }
+    if (entry->prev != NULL) {
+        entry->prev->next = entry->next;
+    } else {
+        *entry->slot = entry->next;
+    }
+    if (entry->next != NULL) {
+        entry->next->prev = entry->prev;
+    }
+    entry->next = NULL;
+    entry->prev = NULL;
+    entry->slot = NULL;
+    entry->armed = false;
+    wheel->armed--;
+}
+
+static void cascade(TimerWheel *wheel, int level) {
+    unsigned int shift = (unsigned int)(level * WHEEL_SLOT_BITS);
+    TimerEntry **slot = &wheel->slots[level][(wheel->now >> shift) & WHEEL_MASK];
+    TimerEntry *entry = *slot;
+    *slot = NULL;
+    while (entry != NULL) {
+        TimerEntry *next = entry->next;
+        link_entry(slot_for(wheel, entry->expires > wheel->now ? entry->expires : wheel->now), entry);
+        entry = next;
+    }
+}
+
+void timer_wheel_advance(TimerWheel *wheel, uint64_t to_tick, TimerFunc expired, void *user_data) {
+    while (wheel->now < to_tick) {
+        wheel->now++;
+        for (int level = WHEEL_LEVELS - 1; level > 0; --level) {
+            uint64_t span_mask = ((uint64_t)1 << (level * WHEEL_SLOT_BITS)) - 1;
+            if ((wheel->now & span_mask) == 0) {
+                cascade(wheel, level);
+            }
+        }
+
+        TimerEntry **slot = &wheel->slots[0][wheel->now & WHEEL_MASK];
+        while (*slot != NULL) {
+            TimerEntry *entry = *slot;
+            *slot = entry->next;
+            if (*slot != NULL) {
+                (*slot)->prev = NULL;
+            }
+            entry->next = NULL;
+            entry->prev = NULL;
+            entry->slot = NULL;
+            entry->armed = false;
+            wheel->armed--;
+            expired(entry, user_data);
+        }
+    }
+}
+
+void token_bucket_init(TokenBucket *bucket, double rate_per_sec, double burst, int64_t now_ns) {
+    bucket->rate_per_sec = rate_per_sec;
+    bucket->burst = burst >= 1.0 ? burst : 1.0;
+    bucket->tokens = bucket->burst;
+    bucket->last_ns = now_ns;
+}
+
+bool token_bucket_take(TokenBucket *bucket, int64_t now_ns) {
+    if (bucket->rate_per_sec <= 0.0) {
+        return true;
+    }
+    if (now_ns > bucket->last_ns) {
+        bucket->tokens += (double)(now_ns - bucket->last_ns) / 1e9 * bucket->rate_per_sec;
+        if (bucket->tokens > bucket->burst) {
+            bucket->tokens = bucket->burst;
+        }
+        bucket->last_ns = now_ns;
+    }
+    if (bucket->tokens < 1.0) {
+        return false;
+    }
+    bucket->tokens -= 1.0;
+    return true;
+}
@@ -0,0 +1,47 @@
+#ifndef NETPULSE_SCHEDULER_H
+#define NETPULSE_SCHEDULER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define WHEEL_TICK_MS 100
+#define WHEEL_LEVELS 3
+#define WHEEL_SLOT_BITS 6
+#define WHEEL_SLOTS (1 << WHEEL_SLOT_BITS)
+
+typedef struct TimerEntry {
+    struct TimerEntry *next;
+    struct TimerEntry *prev;
+    struct TimerEntry **slot;
+    uint64_t expires;
+    bool armed;
+    void *data;
+} TimerEntry;
+
+/* Three 64-slot levels at 100 ms resolution cover about 7 hours; later expiries are parked in the
+   top level and re-filed when they cascade. */
+typedef struct {
+    TimerEntry *slots[WHEEL_LEVELS][WHEEL_SLOTS];
+    uint64_t now;
+    size_t armed;
+} TimerWheel;
+
+typedef void (*TimerFunc)(TimerEntry *entry, void *user_data);
+
+typedef struct {
+    double rate_per_sec;
+    double burst;
+    double tokens;
+    int64_t last_ns;
+} TokenBucket;
+
+void timer_wheel_init(TimerWheel *wheel, uint64_t now_tick);
+void timer_wheel_schedule(TimerWheel *wheel, TimerEntry *entry, uint64_t expires_tick);
+void timer_wheel_cancel(TimerWheel *wheel, TimerEntry *entry);
+void timer_wheel_advance(TimerWheel *wheel, uint64_t to_tick, TimerFunc expired, void *user_data);
+
+void token_bucket_init(TokenBucket *bucket, double rate_per_sec, double burst, int64_t now_ns);
+bool token_bucket_take(TokenBucket *bucket, int64_t now_ns);
+
+#endif
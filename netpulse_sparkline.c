@@ -0,0 +1,250 @@
+#include "netpulse_sparkline.h"
+
+#include <math.h>
+
+/* The cached surface is a ring of SPARKLINE_SAMPLES columns, each SPARKLINE_STEP_PX wide. A new sample
+   overwrites the oldest column and moves the ring head, so a tick draws one column per new sample and the
+   scroll happens when the ring is copied to the cell in two pieces, oldest first. */
+typedef struct {
+    cairo_surface_t *surface;
+    int scale_factor;
+    unsigned long drawn_total;
+    int head;
+    double scale_ms;
+    double last_y;
+    bool has_last;
+} Sparkline;
+
+struct _SparklineRenderer {
+    GtkCellRenderer parent_instance;
+    Target *target;
+    GHashTable *cache;
+};
+
+enum {
+    PROP_0,
+    PROP_TARGET,
+};
+
+G_DEFINE_TYPE(SparklineRenderer, sparkline_renderer, GTK_TYPE_CELL_RENDERER)
+
+static void sparkline_free(gpointer data) {
+    Sparkline *spark = data;
+    if (spark->surface != NULL) {
+        cairo_surface_destroy(spark->surface);
+    }
+    g_free(spark);
+}
+
+/* Top of the graph as 1, 2 or 5 times a power of ten, at least 10 ms. It only moves when the newest
+   samples exceed it or fall below a quarter of it, since a new scale means redrawing every column. */
+static double choose_scale(const Target *target, int count, double current) {
+    double max_ms = 0.0;
+    for (int back = 1; back <= count; ++back) {
+        const HistoryPoint *p = target_history_at(target, target->history_total - (unsigned long)back);
+        if (p->success && p->latency_ms > max_ms) {
+            max_ms = p->latency_ms;
+        }
+    }
+    if (current > 0.0 && max_ms <= current && max_ms * 4.0 > current) {
+        return current;
+    }
+
+    static const double steps[] = {1.0, 2.0, 5.0};
+    for (double decade = 10.0;; decade *= 10.0) {
+        for (size_t i = 0; i < G_N_ELEMENTS(steps); ++i) {
+            if (max_ms <= decade * steps[i]) {
+                return decade * steps[i];
+            }
+        }
+    }
+}
+
+static void draw_sample(Sparkline *spark, cairo_t *cr, const HistoryPoint *p) {
+    double x = spark->head * SPARKLINE_STEP_PX;
+    cairo_save(cr);
+    cairo_rectangle(cr, x, 0, SPARKLINE_STEP_PX, SPARKLINE_HEIGHT_PX);
+    cairo_clip(cr);
+    cairo_set_operator(cr, CAIRO_OPERATOR_CLEAR);
+    cairo_paint(cr);
+    cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
+
+    if (!p->success) {
+        cairo_set_source_rgba(cr, 0.86, 0.2, 0.2, 0.8);
+        cairo_paint(cr);
+        spark->has_last = false;
+    } else if (p->latency_ms >= 0.0) {
+        double y = SPARKLINE_HEIGHT_PX - 1.0 - fmin(p->latency_ms / spark->scale_ms, 1.0) * (SPARKLINE_HEIGHT_PX - 2.0);
+        cairo_set_source_rgb(cr, 0.2, 0.55, 0.95);
+        cairo_set_line_width(cr, 1.0);
+        cairo_move_to(cr, x, spark->has_last ? spark->last_y : y);
+        cairo_line_to(cr, x + SPARKLINE_STEP_PX, y);
+        cairo_stroke(cr);
+        spark->last_y = y;
+        spark->has_last = true;
+    }
+    cairo_restore(cr);
+    spark->head = (spark->head + 1) % SPARKLINE_SAMPLES;
+}
+
+/* Brings the cached surface up to the target's newest sample, drawing only the new columns unless the
+   scale changed or more than a full graph of samples arrived since the last paint. */
+static void sparkline_update(Sparkline *spark, const Target *target) {
+    unsigned long total = target->history_total;
+    if (total == spark->drawn_total) {
+        return;
+    }
+
+    int count = MIN(target->history_count, SPARKLINE_SAMPLES);
+    double scale_ms = choose_scale(target, count, spark->scale_ms);
+    unsigned long from = spark->drawn_total;
+    cairo_t *cr = cairo_create(spark->surface);
+    if (spark->drawn_total == 0 || total < from || total - from >= SPARKLINE_SAMPLES || scale_ms != spark->scale_ms) {
+        cairo_set_operator(cr, CAIRO_OPERATOR_CLEAR);
+        cairo_paint(cr);
+        cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
+        spark->head = 0;
+        spark->has_last = false;
+        from = total - (unsigned long)count;
+    }
+    spark->scale_ms = scale_ms;
+    for (unsigned long seq = from; seq < total; ++seq) {
+        draw_sample(spark, cr, target_history_at(target, seq));
+    }
+    cairo_destroy(cr);
+    spark->drawn_total = total;
+}
+
+static void sparkline_renderer_get_preferred_width(GtkCellRenderer *cell, GtkWidget *widget, gint *minimum,
+                                                   gint *natural) {
+    (void)widget;
+    gint xpad = 0;
+    gint ypad = 0;
+    gtk_cell_renderer_get_padding(cell, &xpad, &ypad);
+    *minimum = SPARKLINE_WIDTH_PX + 2 * xpad;
+    *natural = *minimum;
+}
+
+static void sparkline_renderer_get_preferred_height(GtkCellRenderer *cell, GtkWidget *widget, gint *minimum,
+                                                    gint *natural) {
+    (void)widget;
+    gint xpad = 0;
+    gint ypad = 0;
+    gtk_cell_renderer_get_padding(cell, &xpad, &ypad);
+    *minimum = SPARKLINE_HEIGHT_PX + 2 * ypad;
+    *natural = *minimum;
+}
+
+static void sparkline_renderer_render(GtkCellRenderer *cell, cairo_t *cr, GtkWidget *widget,
+                                      const GdkRectangle *background_area, const GdkRectangle *cell_area,
+                                      GtkCellRendererState flags) {
+    (void)background_area;
+    (void)flags;
+    SparklineRenderer *renderer = NETPULSE_SPARKLINE_RENDERER(cell);
+    Target *target = renderer->target;
+    if (target == NULL) {
+        return;
+    }
+
+    Sparkline *spark = g_hash_table_lookup(renderer->cache, GUINT_TO_POINTER(target->id));
+    if (spark == NULL) {
+        spark = g_new0(Sparkline, 1);
+        g_hash_table_insert(renderer->cache, GUINT_TO_POINTER(target->id), spark);
+    }
+    /* Similar surfaces share the window's device scale, so moving to a HiDPI monitor needs a new one. */
+    int scale_factor = gtk_widget_get_scale_factor(widget);
+    if (spark->surface == NULL || spark->scale_factor != scale_factor) {
+        if (spark->surface != NULL) {
+            cairo_surface_destroy(spark->surface);
+        }
+        spark->surface = cairo_surface_create_similar(cairo_get_target(cr), CAIRO_CONTENT_COLOR_ALPHA,
+                                                      SPARKLINE_WIDTH_PX, SPARKLINE_HEIGHT_PX);
+        spark->scale_factor = scale_factor;
+        spark->drawn_total = 0;
+        spark->scale_ms = 0.0;
+    }
+    sparkline_update(spark, target);
+
+    gint xpad = 0;
+    gint ypad = 0;
+    gtk_cell_renderer_get_padding(cell, &xpad, &ypad);
+    double x = cell_area->x + xpad;
+    double y = cell_area->y + (cell_area->height - SPARKLINE_HEIGHT_PX) / 2;
+    double older = (SPARKLINE_SAMPLES - spark->head) * SPARKLINE_STEP_PX;
+    double newer = spark->head * SPARKLINE_STEP_PX;
+
+    cairo_save(cr);
+    cairo_rectangle(cr, cell_area->x, cell_area->y, cell_area->width, cell_area->height);
+    cairo_clip(cr);
+    cairo_save(cr);
+    cairo_rectangle(cr, x, y, older, SPARKLINE_HEIGHT_PX);
+    cairo_clip(cr);
+    cairo_set_source_surface(cr, spark->surface, x - newer, y);
+    cairo_paint(cr);
+    cairo_restore(cr);
+    if (newer > 0.0) {
+        cairo_rectangle(cr, x + older, y, newer, SPARKLINE_HEIGHT_PX);
+        cairo_clip(cr);
+        cairo_set_source_surface(cr, spark->surface, x + older, y);
+        cairo_paint(cr);
+    }
+    cairo_restore(cr);
+}
+
+static void sparkline_renderer_get_property(GObject *object, guint property_id, GValue *value, GParamSpec *pspec) {
+    SparklineRenderer *renderer = NETPULSE_SPARKLINE_RENDERER(object);
+    if (property_id == PROP_TARGET) {
+        g_value_set_pointer(value, renderer->target);
+    } else {
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
+    }
+}
+
+static void sparkline_renderer_set_property(GObject *object, guint property_id, const GValue *value,
+                                            GParamSpec *pspec) {
+    SparklineRenderer *renderer = NETPULSE_SPARKLINE_RENDERER(object);
+    if (property_id == PROP_TARGET) {
+        renderer->target = g_value_get_pointer(value);
+    } else {
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
+    }
+}
+
+static void sparkline_renderer_finalize(GObject *object) {
+    SparklineRenderer *renderer = NETPULSE_SPARKLINE_RENDERER(object);
+    g_hash_table_destroy(renderer->cache);
+    G_OBJECT_CLASS(sparkline_renderer_parent_class)->finalize(object);
+}
+
+static void sparkline_renderer_class_init(SparklineRendererClass *klass) {
+    GObjectClass *object_class = G_OBJECT_CLASS(klass);
+    GtkCellRendererClass *cell_class = GTK_CELL_RENDERER_CLASS(klass);
+    object_class->finalize = sparkline_renderer_finalize;
+    object_class->get_property = sparkline_renderer_get_property;
+    object_class->set_property = sparkline_renderer_set_property;
+    cell_class->get_preferred_width = sparkline_renderer_get_preferred_width;
+    cell_class->get_preferred_height = sparkline_renderer_get_preferred_height;
+    cell_class->render = sparkline_renderer_render;
+    g_object_class_install_property(object_class, PROP_TARGET,
+                                    g_param_spec_pointer("target", "Target", "Target whose history is drawn",
+                                                         G_PARAM_READWRITE));
+}
+
+static void sparkline_renderer_init(SparklineRenderer *renderer) {
+    renderer->cache = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, sparkline_free);
+}
+
+GtkCellRenderer *sparkline_renderer_new(void) {
+    return g_object_new(NETPULSE_TYPE_SPARKLINE_RENDERER, NULL);
+}
+
+static gboolean target_gone(gpointer key, gpointer value, gpointer user_data) {
+    (void)value;
+    return target_store_lookup_id(user_data, GPOINTER_TO_UINT(key)) == NULL;
+}
+
+/* Drops the cached graphs of removed targets. Ids are never reused, so a stale entry can only waste
+   memory, not show another target's history. */
+void sparkline_renderer_prune(SparklineRenderer *renderer, const TargetStore *store) {
+    g_hash_table_foreach_remove(renderer->cache, target_gone, (gpointer)store);
+}
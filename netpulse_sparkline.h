@@ -0,0 +1,19 @@
+#ifndef NETPULSE_SPARKLINE_H
+#define NETPULSE_SPARKLINE_H
+
+#include <gtk/gtk.h>
+
+#include "netpulse_targets.h"
+
+#define SPARKLINE_SAMPLES 60
+#define SPARKLINE_STEP_PX 2
+#define SPARKLINE_WIDTH_PX (SPARKLINE_SAMPLES * SPARKLINE_STEP_PX)
+#define SPARKLINE_HEIGHT_PX 18
+
+#define NETPULSE_TYPE_SPARKLINE_RENDERER (sparkline_renderer_get_type())
+G_DECLARE_FINAL_TYPE(SparklineRenderer, sparkline_renderer, NETPULSE, SPARKLINE_RENDERER, GtkCellRenderer)
+
+GtkCellRenderer *sparkline_renderer_new(void);
+void sparkline_renderer_prune(SparklineRenderer *renderer, const TargetStore *store);
+
+#endif
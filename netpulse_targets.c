@@ -0,0 +1,795 @@
+#define _POSIX_C_SOURCE 200809L
+#include "netpulse_targets.h"
+
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void trim(char *s) {
+    if (s == NULL) {
+        return;
+    }
+
+    size_t len = strlen(s);
+    while (len > 0 && isspace((unsigned char)s[len - 1])) {
+        s[--len] = '\0';
+    }
+
+    size_t start = 0;
+    while (s[start] != '\0' && isspace((unsigned char)s[start])) {
+        start++;
+    }
+
+    if (start > 0) {
+        memmove(s, s + start, strlen(s + start) + 1);
+    }
+}
+
+bool normalize_target(const char *raw, char *display, size_t display_size, char *host, size_t host_size,
+                      int *port) {
+    if (raw == NULL || display == NULL || host == NULL) {
+        return false;
+    }
+    if (port != NULL) {
+        *port = 0;
+    }
+
+    char temp[256];
+    snprintf(temp, sizeof(temp), "%s", raw);
+    trim(temp);
+    if (temp[0] == '\0') {
+        return false;
+    }
+
+    snprintf(display, display_size, "%s", temp);
+
+    const char *work = temp;
+    const char *scheme = strstr(work, "://");
+    if (scheme != NULL) {
+        work = scheme + 3;
+    }
+
+    char hostbuf[256];
+    size_t i = 0;
+    while (work[i] != '\0' && work[i] != '/' && work[i] != '?' && work[i] != '#') {
+        if (i + 1 >= sizeof(hostbuf)) {
+            break;
+        }
+        hostbuf[i] = work[i];
+        i++;
+    }
+    hostbuf[i] = '\0';
+
+    if (hostbuf[0] == '\0') {
+        return false;
+    }
+
+    char *at = strrchr(hostbuf, '@');
+    char *host_start = at ? at + 1 : hostbuf;
+    if (host_start[0] == '\0') {
+        return false;
+    }
+
+    /* "[v6]:port" and "host:port" carry a port; a bare IPv6 address has several colons and none. */
+    char *port_text = NULL;
+    if (host_start[0] == '[') {
+        char *close = strchr(host_start, ']');
+        if (close != NULL && (close[1] == '\0' || close[1] == ':')) {
+            port_text = close[1] == ':' ? close + 2 : NULL;
+            *close = '\0';
+            host_start++;
+        }
+    } else {
+        char *colon = strchr(host_start, ':');
+        if (colon != NULL && strchr(colon + 1, ':') == NULL && colon[1] != '\0' &&
+            strspn(colon + 1, "0123456789") == strlen(colon + 1)) {
+            port_text = colon + 1;
+            *colon = '\0';
+        }
+    }
+
+    if (port_text != NULL) {
+        char *end = NULL;
+        long value = strtol(port_text, &end, 10);
+        if (end == port_text || *end != '\0' || value < 1 || value > 65535) {
+            return false;
+        }
+        if (port != NULL) {
+            *port = (int)value;
+        }
+    }
+
+    trim(host_start);
+    if (host_start[0] == '\0') {
+        return false;
+    }
+
+    snprintf(host, host_size, "%s", host_start);
+    return true;
+}
+
+int64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int latency_bucket(double latency_ms) {
+    uint64_t us = latency_ms > 0.0 ? (uint64_t)(latency_ms * 1000.0 + 0.5) : 0;
+    if (us < 8) {
+        return (int)us;
+    }
+    int exponent = 63 - __builtin_clzll(us);
+    int bucket = 8 + (exponent - 3) * 8 + (int)((us >> (exponent - 3)) & 7);
+    return bucket < LATENCY_BUCKETS ? bucket : LATENCY_BUCKETS - 1;
+}
+
+static double bucket_midpoint_ms(int bucket) {
+    if (bucket < 8) {
+        return bucket / 1000.0;
+    }
+    int shift = (bucket - 8) / 8;
+    uint64_t lower = (uint64_t)(8 + (bucket - 8) % 8) << shift;
+    uint64_t width = (uint64_t)1 << shift;
+    return (lower + width / 2.0) / 1000.0;
+}
+
+static void histogram_quantiles(const LatencyHistogram *histogram, const double *quantiles, double *values,
+                                size_t count) {
+    int seen = 0;
+    size_t next = 0;
+    for (int bucket = 0; bucket < LATENCY_BUCKETS && next < count; ++bucket) {
+        seen += histogram->counts[bucket];
+        while (next < count && seen > 0 && seen >= (int)ceil(quantiles[next] * histogram->samples)) {
+            values[next++] = bucket_midpoint_ms(bucket);
+        }
+    }
+    while (next < count) {
+        values[next++] = -1.0;
+    }
+}
+
+static void window_push(HistoryWindow *window, const HistoryPoint *p) {
+    window->total++;
+    if (p->success) {
+        window->successes++;
+        if (p->latency_ms >= 0.0) {
+            window->latency_sum += p->latency_ms;
+            if (window->histogram != NULL) {
+                window->histogram->counts[latency_bucket(p->latency_ms)]++;
+                window->histogram->samples++;
+            }
+        }
+    } else {
+        window->failures++;
+    }
+    if (p->jitter_ms >= 0.0) {
+        window->jitter_sum += p->jitter_ms;
+        window->jitter_samples++;
+    }
+}
+
+static void window_pop(HistoryWindow *window, const HistoryPoint *p) {
+    window->total--;
+    if (p->success) {
+        window->successes--;
+        if (p->latency_ms >= 0.0) {
+            window->latency_sum -= p->latency_ms;
+            if (window->histogram != NULL) {
+                window->histogram->counts[latency_bucket(p->latency_ms)]--;
+                window->histogram->samples--;
+            }
+        }
+    } else {
+        window->failures--;
+    }
+    if (p->jitter_ms >= 0.0) {
+        window->jitter_sum -= p->jitter_ms;
+        window->jitter_samples--;
+    }
+    if (window->total == 0) {
+        window->latency_sum = 0.0;
+    }
+    if (window->jitter_samples == 0) {
+        window->jitter_sum = 0.0;
+    }
+    window->tail++;
+}
+
+static void window_expire(Target *target, HistoryWindow *window, int64_t now_ns) {
+    while (window->tail < target->history_total) {
+        const HistoryPoint *p = target_history_at(target, window->tail);
+        if (now_ns - p->mono_ns <= (int64_t)window->span_sec * 1000000000) {
+            break;
+        }
+        window_pop(window, p);
+    }
+}
+
+static void history_expire(Target *target, int64_t now_ns) {
+    window_expire(target, &target->window30, now_ns);
+    window_expire(target, &target->window60, now_ns);
+    window_expire(target, &target->window_stats, now_ns);
+}
+
+/* Rollup sketch bucket i > 0 holds replies in [2^(i+6), 2^(i+7)) us, eight latency buckets at a time, and the
+   first and last also take everything below 128 us and above 2 s. Values are reported at the geometric
+   middle, within a factor of 1.42 of any reply in between. */
+static int sketch_bucket(int latency_index) {
+    int octave = (latency_index >> 3) - 4;
+    return octave < 0 ? 0 : octave >= ROLLUP_SKETCH_BUCKETS ? ROLLUP_SKETCH_BUCKETS - 1 : octave;
+}
+
+static double sketch_value_ms(int bucket) {
+    return bucket == 0 ? 0.064 : ldexp(1.41421356, bucket + 6) / 1000.0;
+}
+
+static void sketch_quantiles(const uint32_t *sketch, const double *quantiles, double *values, size_t count) {
+    guint64 replies = 0;
+    for (int bucket = 0; bucket < ROLLUP_SKETCH_BUCKETS; ++bucket) {
+        replies += sketch[bucket];
+    }
+    guint64 seen = 0;
+    size_t next = 0;
+    for (int bucket = 0; bucket < ROLLUP_SKETCH_BUCKETS && next < count; ++bucket) {
+        seen += sketch[bucket];
+        while (next < count && seen > 0 && seen >= (guint64)ceil(quantiles[next] * (double)replies)) {
+            values[next++] = sketch_value_ms(bucket);
+        }
+    }
+    while (next < count) {
+        values[next++] = -1.0;
+    }
+}
+
+/* Spreads a packed bucket's replies over its scaled counts. Integer maths, so evicting a bucket subtracts
+   exactly what adding it put into the ring totals. */
+static void packed_weights(const RollupBucket *bucket, uint32_t *weights) {
+    uint32_t scaled_total = 0;
+    for (int k = 0; k < ROLLUP_SKETCH_BUCKETS; ++k) {
+        scaled_total += bucket->sketch[k];
+    }
+    for (int k = 0; k < ROLLUP_SKETCH_BUCKETS; ++k) {
+        weights[k] = scaled_total > 0 ? (uint32_t)((uint64_t)bucket->replies * bucket->sketch[k] / scaled_total) : 0;
+    }
+}
+
+static void ring_account(RollupRing *ring, const RollupBucket *bucket, bool add) {
+    uint32_t weights[ROLLUP_SKETCH_BUCKETS];
+    packed_weights(bucket, weights);
+    for (int k = 0; k < ROLLUP_SKETCH_BUCKETS; ++k) {
+        ring->sketch[k] = add ? ring->sketch[k] + weights[k] : ring->sketch[k] - weights[k];
+    }
+    if (add) {
+        ring->samples += bucket->samples;
+        ring->successes += bucket->successes;
+        ring->replies += bucket->replies;
+        ring->latency_sum_ms += bucket->latency_sum_ms;
+    } else {
+        ring->samples -= bucket->samples;
+        ring->successes -= bucket->successes;
+        ring->replies -= bucket->replies;
+        ring->latency_sum_ms -= bucket->latency_sum_ms;
+    }
+}
+
+static void rollup_ring_init(RollupRing *ring, RollupBucket *buckets, int size, int period_sec) {
+    ring->buckets = buckets;
+    ring->size = size;
+    ring->period_sec = period_sec;
+}
+
+static void rollup_evict(RollupRing *ring, RollupBucket *bucket) {
+    if (bucket->samples > 0) {
+        ring_account(ring, bucket, false);
+    }
+    memset(bucket, 0, sizeof(*bucket));
+}
+
+static void rollup_pack(const RollupOpen *open, RollupBucket *bucket) {
+    memset(bucket, 0, sizeof(*bucket));
+    if (open->samples == 0) {
+        return;
+    }
+    double scale = open->samples > UINT16_MAX ? (double)UINT16_MAX / open->samples : 1.0;
+    bucket->samples = (uint16_t)lrint(open->samples * scale);
+    bucket->successes = (uint16_t)lrint(open->successes * scale);
+    bucket->replies = (uint16_t)lrint(open->replies * scale);
+    bucket->latency_sum_ms = (float)(open->latency_sum_ms * scale);
+    bucket->latency_min = open->latency_min;
+    bucket->latency_max = open->latency_max;
+
+    uint32_t peak = 0;
+    for (int k = 0; k < ROLLUP_SKETCH_BUCKETS; ++k) {
+        peak = MAX(peak, open->sketch[k]);
+    }
+    /* Rounded up, so a bucket that saw any reply never packs to zero and the tail survives. */
+    for (int k = 0; k < ROLLUP_SKETCH_BUCKETS && peak > 0; ++k) {
+        bucket->sketch[k] = (uint8_t)(((uint64_t)open->sketch[k] * 255 + peak - 1) / peak);
+    }
+}
+
+/* Moves the ring forward to period. The open period is packed into its slot, and every slot passed on the
+   way is cleared, so a gap in probing reads as no samples rather than as data from a full ring ago. */
+static void rollup_advance(RollupRing *ring, uint32_t period) {
+    if (ring->newest == 0 || period - ring->newest >= (uint32_t)ring->size) {
+        memset(ring->buckets, 0, sizeof(RollupBucket) * (size_t)ring->size);
+        ring->samples = 0;
+        ring->successes = 0;
+        ring->replies = 0;
+        memset(ring->sketch, 0, sizeof(ring->sketch));
+    } else {
+        RollupBucket *closed = &ring->buckets[ring->newest % (uint32_t)ring->size];
+        rollup_evict(ring, closed);
+        rollup_pack(&ring->open, closed);
+        if (closed->samples > 0) {
+            ring_account(ring, closed, true);
+        }
+        for (uint32_t p = ring->newest + 1; p <= period; ++p) {
+            rollup_evict(ring, &ring->buckets[p % (uint32_t)ring->size]);
+        }
+    }
+    if (ring->samples == 0) {
+        ring->latency_sum_ms = 0.0;
+    }
+    memset(&ring->open, 0, sizeof(ring->open));
+    ring->newest = period;
+}
+
+static void rollup_add(RollupRing *ring, time_t timestamp, const HistoryPoint *p) {
+    uint32_t period = (uint32_t)(timestamp / ring->period_sec);
+    if (period > ring->newest) {
+        rollup_advance(ring, period);
+    } else if (ring->newest - period >= (uint32_t)ring->size) {
+        return;
+    }
+
+    /* A late sample, from a relay or a clock step, counts toward the open period. */
+    RollupOpen *open = &ring->open;
+    open->samples++;
+    if (!p->success) {
+        return;
+    }
+    open->successes++;
+    if (p->latency_ms < 0.0) {
+        return;
+    }
+    int bucket = latency_bucket(p->latency_ms);
+    if (open->replies == 0 || bucket < open->latency_min) {
+        open->latency_min = (uint8_t)bucket;
+    }
+    if (open->replies == 0 || bucket > open->latency_max) {
+        open->latency_max = (uint8_t)bucket;
+    }
+    open->replies++;
+    open->latency_sum_ms += p->latency_ms;
+    open->sketch[sketch_bucket(bucket)]++;
+}
+
+static void rollups_add(Target *target, time_t timestamp, const HistoryPoint *p) {
+    if (timestamp <= 0) {
+        return;
+    }
+    if (target->rollups == NULL) {
+        TargetRollups *rollups = g_new0(TargetRollups, 1);
+        rollup_ring_init(&rollups->minutes, rollups->minute_buckets, ROLLUP_MINUTE_SLOTS, 60);
+        rollup_ring_init(&rollups->hours, rollups->hour_buckets, ROLLUP_HOUR_SLOTS, 3600);
+        target->rollups = rollups;
+    }
+    rollup_add(&target->rollups->minutes, timestamp, p);
+    rollup_add(&target->rollups->hours, timestamp, p);
+}
+
+void init_history(Target *target, int stats_window_sec) {
+    target->window30.span_sec = 30;
+    target->window60.span_sec = 60;
+    target->window_stats.span_sec = stats_window_sec;
+    target->window_stats.histogram = &target->latency_histogram;
+}
+
+void add_history(Target *target, bool success, double latency_ms, bool has_latency) {
+    add_history_at(target, time(NULL), monotonic_ns(), success, latency_ms, has_latency);
+}
+
+void add_history_at(Target *target, time_t timestamp, int64_t mono_ns, bool success, double latency_ms,
+                    bool has_latency) {
+    unsigned long seq = target->history_total;
+    if (target->history_count < HISTORY_SIZE) {
+        target->history_count++;
+    } else {
+        /* The slot being overwritten may still sit inside a window when probing faster than 2 Hz. */
+        unsigned long evicted = seq - HISTORY_SIZE;
+        HistoryWindow *windows[] = {&target->window30, &target->window60, &target->window_stats};
+        for (size_t i = 0; i < sizeof(windows) / sizeof(windows[0]); ++i) {
+            if (windows[i]->tail == evicted) {
+                window_pop(windows[i], target_history_at(target, evicted));
+            }
+        }
+        target->history_start = (target->history_start + 1) % HISTORY_SIZE;
+    }
+
+    HistoryPoint *p = &target->history[seq % HISTORY_SIZE];
+    p->timestamp = timestamp;
+    p->mono_ns = mono_ns;
+    p->success = success;
+    p->latency_ms = has_latency ? latency_ms : -1.0;
+    p->jitter_ms = -1.0;
+    if (success && has_latency) {
+        if (target->has_prev_latency) {
+            p->jitter_ms = fabs(latency_ms - target->prev_latency_ms);
+        }
+        target->prev_latency_ms = latency_ms;
+        target->has_prev_latency = true;
+    }
+    target->history_total = seq + 1;
+    target->last_success = success;
+    target->has_latency = has_latency;
+    target->last_latency_ms = latency_ms;
+
+    window_push(&target->window30, p);
+    window_push(&target->window60, p);
+    window_push(&target->window_stats, p);
+    history_expire(target, mono_ns);
+    rollups_add(target, timestamp, p);
+}
+
+void free_history(Target *target) {
+    g_free(target->rollups);
+    target->rollups = NULL;
+}
+
+void compute_status(Target *target) {
+    history_expire(target, monotonic_ns());
+    int drops30 = target->window30.failures;
+    int drops60 = target->window60.failures;
+
+    if (drops60 > 10) {
+        snprintf(target->status, sizeof(target->status), "RED");
+    } else if (drops30 > 3) {
+        snprintf(target->status, sizeof(target->status), "AMBER");
+    } else {
+        snprintf(target->status, sizeof(target->status), "GREEN");
+    }
+}
+
+/* Compares the newest sample with up to LATENCY_BASELINE_SAMPLES earlier replies in the history ring. It
+   is an anomaly when it is both 1.5 times the baseline mean and four mean absolute deviations above it, so
+   neither a quiet target's tiny wobble nor a noisy target's normal spread trips it. */
+bool target_latency_anomaly(const Target *target) {
+    if (target->history_count < 2) {
+        return false;
+    }
+    const HistoryPoint *newest = target_history_at(target, target->history_total - 1);
+    if (!newest->success || newest->latency_ms < 0.0) {
+        return false;
+    }
+
+    double latencies[LATENCY_BASELINE_SAMPLES];
+    int count = 0;
+    double sum = 0.0;
+    for (int back = 2; back <= target->history_count && count < LATENCY_BASELINE_SAMPLES; ++back) {
+        const HistoryPoint *p = target_history_at(target, target->history_total - (unsigned long)back);
+        if (p->success && p->latency_ms >= 0.0) {
+            latencies[count++] = p->latency_ms;
+            sum += p->latency_ms;
+        }
+    }
+    if (count < LATENCY_BASELINE_SAMPLES / 2) {
+        return false;
+    }
+
+    double mean = sum / count;
+    double deviation = 0.0;
+    for (int i = 0; i < count; ++i) {
+        deviation += fabs(latencies[i] - mean);
+    }
+    deviation /= count;
+    return newest->latency_ms > mean * 1.5 && newest->latency_ms > mean + 4.0 * deviation;
+}
+
+void target_window_stats(Target *target, TargetWindowStats *stats) {
+    history_expire(target, monotonic_ns());
+    stats->samples = target->window60.total;
+    stats->successes = target->window60.successes;
+    stats->avg_latency_ms = stats->successes > 0 ? target->window60.latency_sum / stats->successes : -1.0;
+    stats->uptime_pct = stats->samples > 0 ? (100.0 * stats->successes) / stats->samples : -1.0;
+
+    const HistoryWindow *window = &target->window_stats;
+    static const double quantiles[] = {0.50, 0.95, 0.99};
+    double values[3];
+    histogram_quantiles(window->histogram, quantiles, values, 3);
+    stats->window_sec = window->span_sec;
+    stats->p50_ms = values[0];
+    stats->p95_ms = values[1];
+    stats->p99_ms = values[2];
+    stats->jitter_ms = window->jitter_samples > 0 ? fmax(0.0, window->jitter_sum / window->jitter_samples) : -1.0;
+}
+
+/* Stats over the last span_sec seconds, up to an hour from the minute ring and up to thirty days from the
+   hour ring, both counting the current open period. A query over a whole ring reads only its running totals
+   and open period unless with_range asks for min/max; other spans walk their closed buckets. */
+bool target_rollup_stats(Target *target, time_t now, int span_sec, bool with_range, RollupStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    stats->uptime_pct = -1.0;
+    stats->avg_latency_ms = -1.0;
+    stats->min_ms = -1.0;
+    stats->max_ms = -1.0;
+    stats->p50_ms = -1.0;
+    stats->p95_ms = -1.0;
+    stats->p99_ms = -1.0;
+    if (target->rollups == NULL || span_sec <= 0) {
+        return false;
+    }
+
+    RollupRing *ring = span_sec <= ROLLUP_MINUTE_SLOTS * 60 ? &target->rollups->minutes : &target->rollups->hours;
+    uint32_t current = (uint32_t)(now / ring->period_sec);
+    if (current > ring->newest) {
+        rollup_advance(ring, current);
+    }
+    int periods = MIN((span_sec + ring->period_sec - 1) / ring->period_sec, ring->size);
+    bool whole = periods == ring->size;
+
+    const RollupOpen *open = &ring->open;
+    stats->samples = open->samples;
+    stats->successes = open->successes;
+    guint64 replies = open->replies;
+    double latency_sum = open->latency_sum_ms;
+    uint32_t sketch[ROLLUP_SKETCH_BUCKETS];
+    memcpy(sketch, open->sketch, sizeof(sketch));
+    int min_index = open->replies > 0 ? open->latency_min : LATENCY_BUCKETS;
+    int max_index = open->replies > 0 ? open->latency_max : -1;
+    if (whole) {
+        stats->samples += ring->samples;
+        stats->successes += ring->successes;
+        replies += ring->replies;
+        latency_sum += ring->latency_sum_ms;
+        for (int k = 0; k < ROLLUP_SKETCH_BUCKETS; ++k) {
+            sketch[k] += ring->sketch[k];
+        }
+    }
+    for (int back = 1; back < periods && (!whole || with_range); ++back) {
+        const RollupBucket *bucket = &ring->buckets[(ring->newest - (uint32_t)back) % (uint32_t)ring->size];
+        if (bucket->samples == 0) {
+            continue;
+        }
+        if (bucket->replies > 0) {
+            min_index = MIN(min_index, (int)bucket->latency_min);
+            max_index = MAX(max_index, (int)bucket->latency_max);
+        }
+        if (!whole) {
+            uint32_t weights[ROLLUP_SKETCH_BUCKETS];
+            packed_weights(bucket, weights);
+            for (int k = 0; k < ROLLUP_SKETCH_BUCKETS; ++k) {
+                sketch[k] += weights[k];
+            }
+            stats->samples += bucket->samples;
+            stats->successes += bucket->successes;
+            replies += bucket->replies;
+            latency_sum += bucket->latency_sum_ms;
+        }
+    }
+    if (stats->samples == 0) {
+        return false;
+    }
+
+    stats->uptime_pct = (100.0 * (double)stats->successes) / (double)stats->samples;
+    if (replies > 0) {
+        static const double quantiles[] = {0.50, 0.95, 0.99};
+        double values[3];
+        sketch_quantiles(sketch, quantiles, values, 3);
+        stats->avg_latency_ms = latency_sum / (double)replies;
+        stats->p50_ms = values[0];
+        stats->p95_ms = values[1];
+        stats->p99_ms = values[2];
+    }
+    if (with_range && min_index <= max_index) {
+        stats->min_ms = bucket_midpoint_ms(min_index);
+        stats->max_ms = bucket_midpoint_ms(max_index);
+    }
+    return true;
+}
+
+void compute_stats(Target *target, char *latency_text, size_t latency_size, char *avg_text, size_t avg_size,
+                   char *uptime_text, size_t uptime_size) {
+    TargetWindowStats stats;
+    target_window_stats(target, &stats);
+
+    if (target->has_latency) {
+        snprintf(latency_text, latency_size, "%.0f ms", target->last_latency_ms);
+    } else {
+        snprintf(latency_text, latency_size, "--");
+    }
+
+    if (stats.avg_latency_ms >= 0.0) {
+        snprintf(avg_text, avg_size, "%.0f ms", stats.avg_latency_ms);
+    } else {
+        snprintf(avg_text, avg_size, "--");
+    }
+
+    if (stats.uptime_pct >= 0.0) {
+        snprintf(uptime_text, uptime_size, "%.0f%%", stats.uptime_pct);
+    } else {
+        snprintf(uptime_text, uptime_size, "--");
+    }
+}
+
+static void format_ms(char *text, size_t size, double ms) {
+    snprintf(text, size, ms < 10.0 ? "%.1f" : "%.0f", ms);
+}
+
+void compute_tail_stats(Target *target, char *percentile_text, size_t percentile_size, char *jitter_text,
+                        size_t jitter_size) {
+    TargetWindowStats stats;
+    target_window_stats(target, &stats);
+
+    if (stats.p50_ms >= 0.0) {
+        char p50[16];
+        char p95[16];
+        char p99[16];
+        format_ms(p50, sizeof(p50), stats.p50_ms);
+        format_ms(p95, sizeof(p95), stats.p95_ms);
+        format_ms(p99, sizeof(p99), stats.p99_ms);
+        snprintf(percentile_text, percentile_size, "%s / %s / %s ms", p50, p95, p99);
+    } else {
+        snprintf(percentile_text, percentile_size, "--");
+    }
+
+    if (stats.jitter_ms >= 0.0) {
+        char jitter[16];
+        format_ms(jitter, sizeof(jitter), stats.jitter_ms);
+        snprintf(jitter_text, jitter_size, "%s ms", jitter);
+    } else {
+        snprintf(jitter_text, jitter_size, "--");
+    }
+}
+
+/* ICMP targets are keyed by host alone, TCP targets by host and port and HTTP targets by the whole URL,
+   so one host can carry several TCP and HTTP checks. */
+static void make_key(char *key, size_t key_size, TargetProbe probe, const char *display, const char *host,
+                     int port) {
+    if (probe == TARGET_PROBE_HTTP) {
+        snprintf(key, key_size, "%s", display);
+        return;
+    }
+    if (probe == TARGET_PROBE_TCP) {
+        snprintf(key, key_size, "tcp://%s:%d", host, port);
+    } else {
+        snprintf(key, key_size, "%s", host);
+    }
+    for (char *p = key; *p != '\0'; ++p) {
+        *p = (char)g_ascii_tolower(*p);
+    }
+}
+
+static bool parse_target(const char *raw_target, char *display, size_t display_size, char *host, size_t host_size,
+                         int *port, TargetProbe *probe) {
+    if (!normalize_target(raw_target, display, display_size, host, host_size, port)) {
+        return false;
+    }
+    if (g_ascii_strncasecmp(display, "tcp://", 6) == 0) {
+        *probe = TARGET_PROBE_TCP;
+    } else if (g_ascii_strncasecmp(display, "http://", 7) == 0 || g_ascii_strncasecmp(display, "https://", 8) == 0) {
+        *probe = TARGET_PROBE_HTTP;
+    } else {
+        *probe = TARGET_PROBE_ICMP;
+    }
+    return *probe != TARGET_PROBE_TCP || *port > 0;
+}
+
+bool target_key_for(const char *raw_target, char *key, size_t key_size) {
+    char display[256];
+    char host[256];
+    int port;
+    TargetProbe probe;
+    if (!parse_target(raw_target, display, sizeof(display), host, sizeof(host), &port, &probe)) {
+        return false;
+    }
+    make_key(key, key_size, probe, display, host, port);
+    return true;
+}
+
+void target_store_init(TargetStore *store) {
+    store->items = g_ptr_array_new();
+    store->by_key = g_hash_table_new(g_str_hash, g_str_equal);
+    store->by_id = g_hash_table_new(g_direct_hash, g_direct_equal);
+    store->next_id = 0;
+    store->stats_window_sec = DEFAULT_STATS_WINDOW_SEC;
+}
+
+void target_store_clear(TargetStore *store) {
+    for (guint i = 0; i < store->items->len; ++i) {
+        Target *t = g_ptr_array_index(store->items, i);
+        free_history(t);
+        g_free(t);
+    }
+    g_ptr_array_set_size(store->items, 0);
+    g_hash_table_remove_all(store->by_key);
+    g_hash_table_remove_all(store->by_id);
+}
+
+static Target *store_insert(TargetStore *store, const char *raw_target, const char *vantage, bool return_existing,
+                           TargetAddResult *result) {
+    char display[256];
+    char host[256];
+    int port;
+    TargetProbe probe;
+    if (!parse_target(raw_target, display, sizeof(display), host, sizeof(host), &port, &probe)) {
+        *result = TARGET_ADD_INVALID;
+        return NULL;
+    }
+
+    char key[256];
+    make_key(key, sizeof(key), probe, display, host, port);
+    if (vantage != NULL) {
+        size_t len = strlen(key);
+        snprintf(key + len, sizeof(key) - len, "@%s", vantage);
+        len = strlen(display);
+        snprintf(display + len, sizeof(display) - len, "@%s", vantage);
+    }
+    Target *existing = g_hash_table_lookup(store->by_key, key);
+    if (existing != NULL) {
+        *result = TARGET_ADD_DUPLICATE;
+        return return_existing ? existing : NULL;
+    }
+
+    Target *t = g_new0(Target, 1);
+    t->id = ++store->next_id;
+    t->index = store->items->len;
+    t->probe = probe;
+    t->port = port;
+    snprintf(t->key, sizeof(t->key), "%s", key);
+    snprintf(t->display, sizeof(t->display), "%s", display);
+    snprintf(t->host, sizeof(t->host), "%s", host);
+    snprintf(t->status, sizeof(t->status), "OFF");
+    init_history(t, store->stats_window_sec);
+    t->history_slot = -1;
+
+    g_ptr_array_add(store->items, t);
+    g_hash_table_insert(store->by_key, t->key, t);
+    g_hash_table_insert(store->by_id, GUINT_TO_POINTER(t->id), t);
+    *result = TARGET_ADD_OK;
+    return t;
+}
+
+Target *target_store_add(TargetStore *store, const char *raw_target, TargetAddResult *result) {
+    return store_insert(store, raw_target, NULL, false, result);
+}
+
+/* Finds or adds the target an agent reported: "host@vantage" for one vantage point, or the plain target
+   for the combined view when vantage is NULL. An existing target is returned with TARGET_ADD_DUPLICATE. */
+Target *target_store_add_remote(TargetStore *store, const char *raw_target, const char *vantage,
+                                TargetAddResult *result) {
+    return store_insert(store, raw_target, vantage, true, result);
+}
+
+bool target_store_remove(TargetStore *store, unsigned int id) {
+    Target *t = g_hash_table_lookup(store->by_id, GUINT_TO_POINTER(id));
+    if (t == NULL) {
+        return false;
+    }
+
+    g_hash_table_remove(store->by_key, t->key);
+    g_hash_table_remove(store->by_id, GUINT_TO_POINTER(id));
+
+    /* Swap the last target into the hole so removal stays O(1); ids, not positions, identify targets. */
+    guint index = t->index;
+    g_ptr_array_remove_index_fast(store->items, index);
+    if (index < store->items->len) {
+        Target *moved = g_ptr_array_index(store->items, index);
+        moved->index = index;
+    }
+
+    free_history(t);
+    g_free(t);
+    return true;
+}
+
+Target *target_store_lookup_id(const TargetStore *store, unsigned int id) {
+    return g_hash_table_lookup(store->by_id, GUINT_TO_POINTER(id));
+}
+
+Target *target_store_lookup_key(const TargetStore *store, const char *key) {
+    return g_hash_table_lookup(store->by_key, key);
+}
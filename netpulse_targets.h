@@ -0,0 +1,235 @@
+#ifndef NETPULSE_TARGETS_H
+#define NETPULSE_TARGETS_H
+
+#include <glib.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "netpulse_alerts.h"
+#include "netpulse_http.h"
+#include "netpulse_resolver.h"
+#include "netpulse_scheduler.h"
+
+#define HISTORY_SIZE 120
+#define LATENCY_BUCKETS 200
+#define DEFAULT_STATS_WINDOW_SEC 60
+#define LATENCY_BASELINE_SAMPLES 16
+#define ROLLUP_MINUTE_SLOTS 60
+#define ROLLUP_HOUR_SLOTS 720
+#define ROLLUP_SKETCH_BUCKETS 16
+
+typedef struct {
+    time_t timestamp;
+    int64_t mono_ns;
+    bool success;
+    double latency_ms;
+    double jitter_ms;
+} HistoryPoint;
+
+/* Log-linear latency buckets in microseconds: exact below 8 us, then 8 sub-buckets per power of two
+   (at most 12.5% bucket width) up to about 67 s. */
+typedef struct {
+    uint16_t counts[LATENCY_BUCKETS];
+    int samples;
+} LatencyHistogram;
+
+typedef struct {
+    int span_sec;
+    unsigned long tail;
+    int total;
+    int successes;
+    int failures;
+    double latency_sum;
+    double jitter_sum;
+    int jitter_samples;
+    LatencyHistogram *histogram;
+} HistoryWindow;
+
+/* A closed minute or hour in 28 bytes. Min and max are latency bucket indexes (12.5% wide), and the sketch
+   holds one count per power of two of latency from 128 us to 2 s, scaled so its fullest bucket reads 255.
+   Counts past 65535 are scaled down together, which keeps the ratios. */
+typedef struct {
+    float latency_sum_ms;
+    uint16_t samples;
+    uint16_t successes;
+    uint16_t replies;
+    uint8_t latency_min;
+    uint8_t latency_max;
+    uint8_t sketch[ROLLUP_SKETCH_BUCKETS];
+} RollupBucket;
+
+/* The current minute or hour at full resolution; it is packed into a RollupBucket when the period ends. */
+typedef struct {
+    uint32_t samples;
+    uint32_t successes;
+    uint32_t replies;
+    double latency_sum_ms;
+    uint8_t latency_min;
+    uint8_t latency_max;
+    uint32_t sketch[ROLLUP_SKETCH_BUCKETS];
+} RollupOpen;
+
+/* Running totals over the closed buckets, kept so a query spanning the whole ring is O(1). */
+typedef struct {
+    uint32_t newest;
+    int period_sec;
+    int size;
+    RollupOpen open;
+    guint64 samples;
+    guint64 successes;
+    guint64 replies;
+    double latency_sum_ms;
+    uint32_t sketch[ROLLUP_SKETCH_BUCKETS];
+    RollupBucket *buckets;
+} RollupRing;
+
+typedef struct {
+    RollupRing minutes;
+    RollupRing hours;
+    RollupBucket minute_buckets[ROLLUP_MINUTE_SLOTS];
+    RollupBucket hour_buckets[ROLLUP_HOUR_SLOTS];
+} TargetRollups;
+
+typedef struct {
+    guint64 samples;
+    guint64 successes;
+    double uptime_pct;
+    double avg_latency_ms;
+    double min_ms;
+    double max_ms;
+    double p50_ms;
+    double p95_ms;
+    double p99_ms;
+} RollupStats;
+
+typedef enum {
+    TARGET_PROBE_ICMP,
+    TARGET_PROBE_TCP,
+    TARGET_PROBE_HTTP,
+} TargetProbe;
+
+typedef struct {
+    unsigned int id;
+    unsigned int index;
+    TargetProbe probe;
+    int port;
+    char key[256];
+    int history_slot;
+    int interval_ms;
+    int timeout_ms;
+    TimerEntry timer;
+    uint64_t next_due_tick;
+    int64_t due_ns;
+    uint64_t queued_denials;
+    bool in_flight;
+    bool queued;
+    bool remote;
+    bool relay_announced;
+    int adaptive_ms;
+    int stable_samples;
+    char display[256];
+    char host[256];
+    char address[DNS_ADDRESS_LEN];
+    double resolve_ms;
+    bool has_resolve;
+    bool resolve_failed;
+    HistoryPoint history[HISTORY_SIZE];
+    int history_count;
+    int history_start;
+    unsigned long history_total;
+    HistoryWindow window30;
+    HistoryWindow window60;
+    HistoryWindow window_stats;
+    LatencyHistogram latency_histogram;
+    TargetRollups *rollups;
+    double prev_latency_ms;
+    bool has_prev_latency;
+    char status[8];
+    FlapState flap;
+    bool last_success;
+    double last_latency_ms;
+    bool has_latency;
+    const char *last_failure;
+    double loss_pct;
+    bool has_loss;
+    double reported_jitter_ms;
+    bool has_reported_jitter;
+    int samples;
+    double latency_min_ms;
+    double latency_max_ms;
+    bool has_latency_range;
+    double phase_ms[HTTP_PHASE_COUNT];
+    bool has_phases;
+    int phase_limit_ms[HTTP_PHASE_COUNT];
+} Target;
+
+typedef struct {
+    int samples;
+    int successes;
+    double avg_latency_ms;
+    double uptime_pct;
+    int window_sec;
+    double p50_ms;
+    double p95_ms;
+    double p99_ms;
+    double jitter_ms;
+} TargetWindowStats;
+
+typedef enum {
+    TARGET_ADD_OK,
+    TARGET_ADD_INVALID,
+    TARGET_ADD_DUPLICATE,
+} TargetAddResult;
+
+typedef struct {
+    GPtrArray *items;
+    GHashTable *by_key;
+    GHashTable *by_id;
+    unsigned int next_id;
+    int stats_window_sec;
+} TargetStore;
+
+void trim(char *s);
+bool normalize_target(const char *raw, char *display, size_t display_size, char *host, size_t host_size,
+                      int *port);
+bool target_key_for(const char *raw_target, char *key, size_t key_size);
+
+int64_t monotonic_ns(void);
+void init_history(Target *target, int stats_window_sec);
+void add_history(Target *target, bool success, double latency_ms, bool has_latency);
+void add_history_at(Target *target, time_t timestamp, int64_t mono_ns, bool success, double latency_ms,
+                    bool has_latency);
+void compute_status(Target *target);
+bool target_latency_anomaly(const Target *target);
+void target_window_stats(Target *target, TargetWindowStats *stats);
+void compute_stats(Target *target, char *latency_text, size_t latency_size, char *avg_text, size_t avg_size,
+                   char *uptime_text, size_t uptime_size);
+void compute_tail_stats(Target *target, char *percentile_text, size_t percentile_size, char *jitter_text,
+                        size_t jitter_size);
+bool target_rollup_stats(Target *target, time_t now, int span_sec, bool with_range, RollupStats *stats);
+void free_history(Target *target);
+
+void target_store_init(TargetStore *store);
+void target_store_clear(TargetStore *store);
+Target *target_store_add(TargetStore *store, const char *raw_target, TargetAddResult *result);
+Target *target_store_add_remote(TargetStore *store, const char *raw_target, const char *vantage,
+                                TargetAddResult *result);
+bool target_store_remove(TargetStore *store, unsigned int id);
+Target *target_store_lookup_id(const TargetStore *store, unsigned int id);
+Target *target_store_lookup_key(const TargetStore *store, const char *key);
+
+static inline const HistoryPoint *target_history_at(const Target *target, unsigned long seq) {
+    return &target->history[seq % HISTORY_SIZE];
+}
+
+static inline size_t target_store_count(const TargetStore *store) {
+    return store->items->len;
+}
+
+static inline Target *target_store_at(const TargetStore *store, size_t index) {
+    return g_ptr_array_index(store->items, index);
+}
+
+#endif
@@ -0,0 +1,234 @@
+#define _DEFAULT_SOURCE
+#include "netpulse_tcp.h"
+
+#include <errno.h>
+#include <netdb.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define TCP_EVENT_BATCH 256
+#define TCP_MIN_PER_RUN 64
+#define TCP_MAX_PER_RUN 16384
+#define TCP_RESERVED_FDS 128
+#define TCP_MIN_GRANT 16
+
+static pthread_mutex_t budget_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t budget_freed = PTHREAD_COND_INITIALIZER;
+static size_t budget_used;
+
+static double elapsed_ms(const struct timespec *from, const struct timespec *to) {
+    return (double)(to->tv_sec - from->tv_sec) * 1000.0 + (double)(to->tv_nsec - from->tv_nsec) / 1e6;
+}
+
+/* Descriptors all TCP batches together may hold, leaving room for the rest of the process. */
+static size_t fd_budget(void) {
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) != 0 || limit.rlim_cur == RLIM_INFINITY) {
+        return TCP_MAX_PER_RUN;
+    }
+    if (limit.rlim_cur <= TCP_MIN_PER_RUN + TCP_RESERVED_FDS) {
+        return TCP_MIN_PER_RUN;
+    }
+    size_t usable = (size_t)limit.rlim_cur - TCP_RESERVED_FDS;
+    return usable < TCP_MAX_PER_RUN ? usable : TCP_MAX_PER_RUN;
+}
+
+/* A new batch job starts every tick and several run at once, each holding its sockets for up to the
+   timeout, so the budget is shared by the process rather than per run. Waits until a small share is free
+   and returns how many descriptors were granted, up to wanted. */
+static size_t acquire_fds(size_t wanted) {
+    size_t budget = fd_budget();
+    size_t least = wanted < TCP_MIN_GRANT ? wanted : TCP_MIN_GRANT;
+    pthread_mutex_lock(&budget_lock);
+    while (budget_used + least > budget) {
+        pthread_cond_wait(&budget_freed, &budget_lock);
+    }
+    size_t granted = budget - budget_used < wanted ? budget - budget_used : wanted;
+    budget_used += granted;
+    pthread_mutex_unlock(&budget_lock);
+    return granted;
+}
+
+static void release_fds(size_t count) {
+    pthread_mutex_lock(&budget_lock);
+    budget_used -= count;
+    pthread_cond_broadcast(&budget_freed);
+    pthread_mutex_unlock(&budget_lock);
+}
+
+static TcpConnectResult classify_error(int error) {
+    switch (error) {
+    case 0:
+        return TCP_CONNECT_OK;
+    case ECONNREFUSED:
+    case ECONNRESET:
+        return TCP_CONNECT_REFUSED;
+    case ETIMEDOUT:
+        return TCP_CONNECT_TIMEOUT;
+    case ENETUNREACH:
+    case EHOSTUNREACH:
+    case ENETDOWN:
+    case EHOSTDOWN:
+        return TCP_CONNECT_UNREACHABLE;
+    default:
+        return TCP_CONNECT_ERROR;
+    }
+}
+
+/* Resets instead of closing gracefully, so thousands of probes do not pile up in TIME_WAIT. */
+static void close_probe(TcpProbe *probe) {
+    struct linger reset = {.l_onoff = 1, .l_linger = 0};
+    setsockopt(probe->fd, SOL_SOCKET, SO_LINGER, &reset, sizeof(reset));
+    close(probe->fd);
+    probe->fd = -1;
+}
+
+static void finish_probe(TcpProbe *probe, int error, const struct timespec *now) {
+    probe->result = classify_error(error);
+    probe->success = probe->result == TCP_CONNECT_OK;
+    if (probe->success) {
+        probe->latency_ms = elapsed_ms(&probe->started_at, now);
+        probe->has_latency = true;
+    }
+    close_probe(probe);
+}
+
+static bool start_connect(int epfd, TcpProbe *probe, uint32_t index) {
+    char service[8];
+    snprintf(service, sizeof(service), "%d", probe->port);
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_NUMERICSERV;
+
+    struct addrinfo *res = NULL;
+    if (getaddrinfo(probe->host, service, &hints, &res) != 0 || res == NULL) {
+        probe->result = TCP_CONNECT_UNREACHABLE;
+        return false;
+    }
+
+    probe->fd = socket(res->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (probe->fd < 0) {
+        freeaddrinfo(res);
+        probe->result = TCP_CONNECT_ERROR;
+        return false;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &probe->started_at);
+    int rc = connect(probe->fd, res->ai_addr, res->ai_addrlen);
+    int error = rc == 0 ? 0 : errno;
+    freeaddrinfo(res);
+    if (error != EINPROGRESS) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        finish_probe(probe, error, &now);
+        return false;
+    }
+
+    struct epoll_event event = {.events = EPOLLOUT, .data.u32 = index};
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, probe->fd, &event) != 0) {
+        probe->result = TCP_CONNECT_ERROR;
+        close_probe(probe);
+        return false;
+    }
+    return true;
+}
+
+static size_t collect_events(int epfd, TcpProbe *probes, int timeout_ms) {
+    struct epoll_event events[TCP_EVENT_BATCH];
+    int ready = epoll_wait(epfd, events, TCP_EVENT_BATCH, timeout_ms);
+    if (ready <= 0) {
+        return 0;
+    }
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    for (int i = 0; i < ready; ++i) {
+        TcpProbe *probe = &probes[events[i].data.u32];
+        int error = 0;
+        socklen_t len = sizeof(error);
+        if (getsockopt(probe->fd, SOL_SOCKET, SO_ERROR, &error, &len) != 0) {
+            error = errno;
+        }
+        finish_probe(probe, error, &now);
+    }
+    return (size_t)ready;
+}
+
+static void run_chunk(TcpProbe *probes, size_t count, int timeout_ms) {
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    for (size_t i = 0; i < count; ++i) {
+        probes[i].fd = -1;
+        probes[i].success = false;
+        probes[i].has_latency = false;
+        probes[i].result = TCP_CONNECT_ERROR;
+    }
+    if (epfd < 0) {
+        return;
+    }
+
+    /* Completions are collected between batches of connects, so early handshakes are timed when they
+       finish rather than after every socket has been opened. */
+    size_t pending = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (probes[i].host != NULL && start_connect(epfd, &probes[i], (uint32_t)i)) {
+            pending++;
+        }
+        if (i % TCP_EVENT_BATCH == TCP_EVENT_BATCH - 1) {
+            pending -= collect_events(epfd, probes, 0);
+        }
+    }
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (pending > 0) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        int remaining = timeout_ms - (int)elapsed_ms(&start, &now);
+        if (remaining <= 0) {
+            break;
+        }
+
+        pending -= collect_events(epfd, probes, remaining);
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        if (probes[i].fd >= 0) {
+            probes[i].result = TCP_CONNECT_TIMEOUT;
+            close_probe(&probes[i]);
+        }
+    }
+    close(epfd);
+}
+
+void tcp_probe_run(TcpProbe *probes, size_t count, int timeout_ms) {
+    size_t offset = 0;
+    while (offset < count) {
+        /* One descriptor of each grant is the chunk's epoll set. */
+        size_t granted = acquire_fds(count - offset + 1);
+        size_t chunk = granted - 1;
+        run_chunk(probes + offset, chunk, timeout_ms);
+        release_fds(granted);
+        offset += chunk;
+    }
+}
+
+const char *tcp_connect_result_name(TcpConnectResult result) {
+    switch (result) {
+    case TCP_CONNECT_OK:
+        return "ok";
+    case TCP_CONNECT_REFUSED:
+        return "refused";
+    case TCP_CONNECT_TIMEOUT:
+        return "timeout";
+    case TCP_CONNECT_UNREACHABLE:
+        return "unreachable";
+    default:
+        return "error";
+    }
+}
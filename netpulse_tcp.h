@@ -0,0 +1,31 @@
+#ifndef NETPULSE_TCP_H
+#define NETPULSE_TCP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+
+typedef enum {
+    TCP_CONNECT_OK,
+    TCP_CONNECT_REFUSED,
+    TCP_CONNECT_TIMEOUT,
+    TCP_CONNECT_UNREACHABLE,
+    TCP_CONNECT_ERROR,
+} TcpConnectResult;
+
+typedef struct {
+    const char *host;
+    int port;
+    TcpConnectResult result;
+    bool success;
+    double latency_ms;
+    bool has_latency;
+
+    int fd;
+    struct timespec started_at;
+} TcpProbe;
+
+void tcp_probe_run(TcpProbe *probes, size_t count, int timeout_ms);
+const char *tcp_connect_result_name(TcpConnectResult result);
+
+#endif